@@ -0,0 +1,123 @@
+#include "Batch.h"
+#include "WordCloudGenerator.h"
+#include "ImageOutput.h"
+#include "WordCountTable.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+#include <atomic>
+#include <thread>
+
+bool parseManifest(const QString &path, std::vector<BatchJob> &jobs) {
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "Error: Can`t open manifest" << path;
+        return false;
+    }
+
+    const QDir base = QFileInfo(path).dir();
+    int line = 0;
+
+    while (!file.atEnd()) {
+        line++;
+        const QString text = QString::fromUtf8(file.readLine()).trimmed();
+        if (text.isEmpty() || text.startsWith('#')) continue;
+
+        const QStringList fields = text.split('\t');
+        if (fields.size() < 5 || fields.size() > 6) {
+            qCritical() << "Error: Manifest line" << line << "must have 5 or 6 tab-separated fields";
+            return false;
+        }
+
+        BatchJob job;
+        job.input = base.filePath(fields.at(0).trimmed());
+        job.shape = fields.at(1).trimmed().toLower();
+        job.size = QSize(fields.at(2).toInt(), fields.at(3).toInt());
+        job.output = base.filePath(fields.at(4).trimmed());
+        // qHash зависит от случайного зерна процесса, поэтому хэш свой: те же цвета при каждом запуске
+        const QByteArray outputName = fields.at(4).trimmed().toUtf8();
+        job.seed = static_cast<quint32>(WordCountTable::hash(std::string_view(outputName.constData(), outputName.size())));
+        job.line = line;
+
+        if (!WordCloudGenerator::shapes().contains(job.shape)) {
+            qCritical() << "Error: Unknown shape on manifest line" << line << ":" << job.shape;
+            return false;
+        }
+
+        if (job.size.width() < 100 || job.size.height() < 100) {
+            qCritical() << "Error: Minimum image size is 100 by 100 pixels, manifest line" << line;
+            return false;
+        }
+
+        if (fields.size() == 6) {
+            bool ok = false;
+            job.seed = fields.at(5).trimmed().toUInt(&ok);
+            if (!ok) {
+                qCritical() << "Error: Invalid seed on manifest line" << line;
+                return false;
+            }
+        }
+
+        jobs.push_back(job);
+    }
+
+    return true;
+}
+
+namespace {
+
+bool runJob(WordCloudGenerator &generator, const BatchJob &job) {
+    generator.setShape(job.shape);
+    generator.setSeed(job.seed);
+
+    if (!generator.processFile(job.input)) {
+        qCritical() << "Error: Can`t read file" << job.input << "(manifest line" << job.line << ")";
+        return false;
+    }
+
+    // формат по расширению выхода, неизвестные расширения пишутся в JPG, как раньше
+    ImageOptions options;
+    outputFormatFromName(QFileInfo(job.output).suffix(), options.format);
+
+    const Layout layout = generator.computeLayout(job.size);
+    QSaveFile file(job.output);
+
+    if (!file.open(QIODevice::WriteOnly) || !writeImage(layout, job.size, options, file, &generator.glyphs())
+        || !file.commit()) {
+        qCritical() << "Error: Can`t save an image" << job.output << "(manifest line" << job.line << ")";
+        return false;
+    }
+    return true;
+}
+
+}
+
+int runBatch(const std::vector<BatchJob> &jobs, int threads, int maxWords) {
+    std::atomic<size_t> next{0};
+    std::atomic<int> failed{0};
+
+    // потоки разбирают задания по одному; генератор на поток, чтобы кэш шрифтов переживал задания
+    auto worker = [&]() {
+        WordCloudGenerator generator;
+        generator.setMaxWords(maxWords);
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            if (!runJob(generator, jobs[i])) failed++;
+        }
+    };
+
+    const int workers = std::max(1, std::min(threads, static_cast<int>(jobs.size())));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < workers; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    return failed;
+}
@@ -0,0 +1,27 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <QSize>
+#include <QString>
+#include <vector>
+
+// Пакетный режим: много облаков в одном процессе, без повторного запуска и загрузки шрифтов.
+// Манифест - текстовый файл, по заданию на строку, поля через табуляцию:
+//   вход  форма  ширина  высота  выход  [seed]
+// Пустые строки и строки с # пропускаются, относительные пути берутся от папки манифеста.
+struct BatchJob {
+    QString input;
+    QString shape;
+    QSize size;
+    QString output;
+    quint32 seed;  // по умолчанию - хэш имени выхода из манифеста, так что цвета не зависят от порядка заданий и запуска
+    int line;
+};
+
+bool parseManifest(const QString &path, std::vector<BatchJob> &jobs);
+
+// Выполняет задания на threads потоках; у каждого потока свой генератор и свои картинки.
+// Возвращает число неудачных заданий.
+int runBatch(const std::vector<BatchJob> &jobs, int threads, int maxWords = 0);
+
+#endif
@@ -0,0 +1,203 @@
+#include "CountSnapshot.h"
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace {
+
+const char MAGIC[8] = {'W', 'C', 'C', 'O', 'U', 'N', 'T', 'S'};
+constexpr std::size_t HEADER_SIZE = 32;
+
+std::uint64_t alignedTo8(std::uint64_t n) {
+    return (n + 7) & ~std::uint64_t(7);
+}
+
+}
+
+bool CountSnapshot::open(const QString &path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(HEADER_SIZE)) return false;
+
+    const qint64 fileSize = file.size();
+    data = file.map(0, fileSize);
+    if (data == nullptr) return false;
+
+    const std::uint64_t wordCount = qFromLittleEndian<quint64>(data + 16);
+    const std::uint64_t stringBytes = qFromLittleEndian<quint64>(data + 24);
+    // размеры проверяются до умножения, чтобы испорченный заголовок не дал переполнения
+    const bool fits = std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0
+        && qFromLittleEndian<quint32>(data + 8) == VERSION
+        && stringBytes <= std::numeric_limits<std::uint32_t>::max()
+        && wordCount <= std::uint64_t(fileSize) / 12
+        && HEADER_SIZE + alignedTo8(stringBytes) + wordCount * 12 + 4 == std::uint64_t(fileSize);
+    if (!fits) {
+        close();
+        return false;
+    }
+
+    words = static_cast<std::size_t>(wordCount);
+    strings = data + HEADER_SIZE;
+    counts = strings + alignedTo8(stringBytes);
+    offsets = counts + words * 8;
+
+    // смещения должны не убывать и закончиться ровно на конце строк, иначе word() выйдет за файл
+    std::uint32_t previous = 0;
+    for (std::size_t i = 0; i <= words; i++) {
+        const std::uint32_t offset = qFromLittleEndian<quint32>(offsets + i * 4);
+        if (offset < previous || (i == 0 && offset != 0)) {
+            close();
+            return false;
+        }
+        previous = offset;
+    }
+    if (previous != stringBytes) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CountSnapshot::close() {
+    if (data != nullptr) file.unmap(const_cast<uchar *>(data));
+    file.close();
+    data = strings = counts = offsets = nullptr;
+    words = 0;
+}
+
+std::string_view CountSnapshot::word(std::size_t i) const {
+    const std::uint32_t begin = qFromLittleEndian<quint32>(offsets + i * 4);
+    const std::uint32_t end = qFromLittleEndian<quint32>(offsets + (i + 1) * 4);
+    return std::string_view(reinterpret_cast<const char *>(strings) + begin, end - begin);
+}
+
+CountSnapshot::Count CountSnapshot::count(std::size_t i) const {
+    return qFromLittleEndian<qint64>(counts + i * 8);
+}
+
+bool CountSnapshot::find(std::string_view needle, Count &value) const {
+    std::size_t low = 0;
+    std::size_t high = words;
+    while (low < high) {
+        const std::size_t middle = low + (high - low) / 2;
+        const int order = word(middle).compare(needle);
+        if (order == 0) {
+            value = count(middle);
+            return true;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+bool CountSnapshot::save(const QString &path, const WordCountTable &table) {
+    std::vector<std::pair<std::string_view, Count>> entries;
+    entries.reserve(table.size());
+    table.forEach([&](std::string_view word, Count n) { entries.emplace_back(word, n); });
+    std::sort(entries.begin(), entries.end());
+
+    CountSnapshotWriter writer(path);
+    if (!writer.open()) return false;
+    for (const auto &entry : entries) {
+        if (!writer.add(entry.first, entry.second)) return false;
+    }
+    return writer.commit();
+}
+
+bool CountSnapshotWriter::open() {
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    // заголовок перезаписывается в commit(), когда известны размеры
+    const char header[HEADER_SIZE] = {};
+    return file.write(header, HEADER_SIZE) == qint64(HEADER_SIZE);
+}
+
+bool CountSnapshotWriter::add(std::string_view word, Count count) {
+    if (failed) return false;
+    const std::uint64_t end = std::uint64_t(offsets.back()) + word.size();
+    if ((counts.size() > 0 && word <= last) || end > std::numeric_limits<std::uint32_t>::max()
+        || file.write(word.data(), qint64(word.size())) != qint64(word.size())) {
+        failed = true;
+        return false;
+    }
+    last.assign(word.data(), word.size());
+    counts.push_back(count);
+    offsets.push_back(static_cast<std::uint32_t>(end));
+    return true;
+}
+
+bool CountSnapshotWriter::commit() {
+    if (failed) return false;
+
+    const std::uint64_t stringBytes = offsets.back();
+    const char padding[8] = {};
+    const qint64 padBytes = qint64(alignedTo8(stringBytes) - stringBytes);
+    if (file.write(padding, padBytes) != padBytes) return false;
+
+    // на little-endian машине массивы пишутся как есть, иначе переставляются байты
+    std::vector<char> bytes(counts.size() * 8 + offsets.size() * 4);
+    qToLittleEndian<qint64>(counts.data(), qsizetype(counts.size()), bytes.data());
+    qToLittleEndian<quint32>(offsets.data(), qsizetype(offsets.size()), bytes.data() + counts.size() * 8);
+    if (file.write(bytes.data(), qint64(bytes.size())) != qint64(bytes.size())) return false;
+
+    char header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    qToLittleEndian<quint32>(CountSnapshot::VERSION, header + 8);
+    qToLittleEndian<quint64>(counts.size(), header + 16);
+    qToLittleEndian<quint64>(stringBytes, header + 24);
+    if (!file.seek(0) || file.write(header, HEADER_SIZE) != qint64(HEADER_SIZE)) return false;
+
+    return file.commit();
+}
+
+bool mergeCountSnapshots(const QStringList &inputs, const QString &output) {
+    std::vector<CountSnapshot> snapshots(inputs.size());
+    for (qsizetype i = 0; i < inputs.size(); i++) {
+        if (!snapshots[i].open(inputs.at(i))) {
+            qCritical() << "Error: Can`t read counts snapshot" << inputs.at(i);
+            return false;
+        }
+    }
+
+    // в куче по одному текущему слову от каждого снимка, на вершине наименьшее
+    using Cursor = std::pair<std::string_view, std::size_t>;  // слово и номер снимка
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+    std::vector<std::size_t> positions(snapshots.size(), 0);
+    for (std::size_t s = 0; s < snapshots.size(); s++) {
+        if (snapshots[s].size() > 0) heap.push({snapshots[s].word(0), s});
+    }
+
+    CountSnapshotWriter writer(output);
+    if (!writer.open()) {
+        qCritical() << "Error: Can`t save counts snapshot" << output;
+        return false;
+    }
+
+    while (!heap.empty()) {
+        const std::string_view word = heap.top().first;
+        CountSnapshot::Count total = 0;
+        while (!heap.empty() && heap.top().first == word) {
+            const std::size_t s = heap.top().second;
+            heap.pop();
+            total += snapshots[s].count(positions[s]);
+            if (++positions[s] < snapshots[s].size()) heap.push({snapshots[s].word(positions[s]), s});
+        }
+        if (!writer.add(word, total)) {
+            qCritical() << "Error: Can`t save counts snapshot" << output << "(inputs must be sorted snapshots)";
+            return false;
+        }
+    }
+
+    if (!writer.commit()) {
+        qCritical() << "Error: Can`t save counts snapshot" << output;
+        return false;
+    }
+    return true;
+}
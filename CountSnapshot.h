@@ -0,0 +1,70 @@
+#ifndef COUNTSNAPSHOT_H
+#define COUNTSNAPSHOT_H
+
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "WordCountTable.h"
+
+// Снимок частот слов в двоичном файле, который читается через mmap без разбора.
+// Все числа little-endian:
+//   заголовок (32 байта): "WCCOUNTS", версия u32, резерв u32, число слов u64, размер строк u64
+//   строки: слова UTF-8 подряд, отсортированные побайтово по возрастанию, без разделителей
+//   выравнивание нулями до 8 байт
+//   частоты: i64 на слово
+//   смещения: u32 на слово плюс конечное, слово i - строки[offsets[i], offsets[i + 1])
+class CountSnapshot {
+public:
+    using Count = WordCountTable::Count;
+
+    static constexpr std::uint32_t VERSION = 1;
+
+    bool open(const QString &path);
+    void close();
+
+    std::size_t size() const { return words; }
+    std::string_view word(std::size_t i) const;
+    Count count(std::size_t i) const;
+    // Двоичный поиск по словам; если слова нет, возвращает false и не трогает count.
+    bool find(std::string_view word, Count &count) const;
+
+    // Сохраняет таблицу целиком, слова сортируются.
+    static bool save(const QString &path, const WordCountTable &table);
+
+private:
+    QFile file;
+    const uchar *data = nullptr;
+    std::size_t words = 0;
+    const uchar *strings = nullptr;
+    const uchar *counts = nullptr;
+    const uchar *offsets = nullptr;
+};
+
+// Потоковая запись снимка: слова подаются строго по возрастанию, строки сразу уходят в файл,
+// в памяти копятся только частоты и смещения (12 байт на слово).
+class CountSnapshotWriter {
+public:
+    using Count = WordCountTable::Count;
+
+    explicit CountSnapshotWriter(const QString &path) : file(path) {}
+
+    bool open();
+    bool add(std::string_view word, Count count);
+    bool commit();
+
+private:
+    QSaveFile file;
+    std::vector<Count> counts;
+    std::vector<std::uint32_t> offsets{0};
+    std::string last;
+    bool failed = false;
+};
+
+// Сливает снимки шардов в один (k-путевое слияние отсортированных списков), частоты одинаковых слов складываются.
+bool mergeCountSnapshots(const QStringList &inputs, const QString &output);
+
+#endif
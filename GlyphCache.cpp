@@ -0,0 +1,36 @@
+#include "GlyphCache.h"
+#include "Profiler.h"
+#include <QTransform>
+
+GlyphCache::Glyphs GlyphCache::lookup(const QString &family, int size, int weight, const QString &word) {
+    auto fontIt = fonts.find(std::make_tuple(family, size, weight));
+    if (fontIt == fonts.end()) {
+        fontIt = fonts.emplace(std::make_tuple(family, size, weight), Font(QFont(family, size, weight))).first;
+    }
+    Font &font = fontIt->second;
+
+    auto wordIt = font.words.find(word);
+    if (wordIt == font.words.end()) {
+        Profiler::Scope scope(Profiler::Stage::Shape);
+        Profiler::add(Profiler::Counter::GlyphMisses);
+        if (wordCount >= MAX_WORDS) {
+            // окно или новые тексты постоянно меняют набор слов - не даём кэшу расти без предела
+            for (auto &entry : fonts) entry.second.words.clear();
+            wordCount = 0;
+        }
+
+        Word entry{QStaticText(word), font.metrics.horizontalAdvance(word)};
+        entry.text.setTextFormat(Qt::PlainText);
+        entry.text.setPerformanceHint(QStaticText::AggressiveCaching);
+        entry.text.prepare(QTransform(), font.font);
+        wordIt = font.words.insert(word, entry);
+        wordCount++;
+    }
+
+    return {&font.font, &wordIt->text, wordIt->width, font.metrics.height(), font.metrics.ascent()};
+}
+
+void GlyphCache::clear() {
+    fonts.clear();
+    wordCount = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QHash>
+#include <QStaticText>
+#include <QString>
+#include <map>
+#include <tuple>
+
+// Кэш шрифтов, метрик и заранее разложенного в глифы текста для отрисовки слов.
+// Ключ - (семейство, размер, насыщенность, слово): при повторной отрисовке тех же слов
+// не создаются QFont/QFontMetrics и строка не разбирается заново.
+class GlyphCache {
+public:
+    struct Glyphs {
+        const QFont *font;
+        const QStaticText *text;
+        int width;    // horizontalAdvance слова
+        int height;   // высота строки шрифта
+        int ascent;   // от верха QStaticText до базовой линии
+    };
+
+    // Указатели в результате действительны до следующего lookup или clear.
+    Glyphs lookup(const QString &family, int size, int weight, const QString &word);
+    void clear();
+
+    size_t size() const { return wordCount; }
+    size_t fontCount() const { return fonts.size(); }
+
+private:
+    struct Word {
+        QStaticText text;
+        int width;
+    };
+
+    struct Font {
+        explicit Font(const QFont &f) : font(f), metrics(f) {}
+        QFont font;
+        QFontMetrics metrics;
+        QHash<QString, Word> words;
+    };
+
+    // шрифтов немного (размеры 10-50), слов - столько, сколько их на картинках
+    std::map<std::tuple<QString, int, int>, Font> fonts;
+    size_t wordCount = 0;
+
+    static constexpr size_t MAX_WORDS = 16384;
+};
+
+#endif
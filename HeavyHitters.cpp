@@ -0,0 +1,145 @@
+#include "HeavyHitters.h"
+#include "WordCountTable.h"
+#include <algorithm>
+
+HeavyHitters::HeavyHitters(std::size_t capacity, std::size_t sketchWidth, std::size_t sketchDepth)
+    : maxCounters(std::max<std::size_t>(capacity, 1)),
+      width(sketchWidth),
+      depth(sketchWidth > 0 ? std::max<std::size_t>(sketchDepth, 1) : 0) {
+    // слова хранятся в std::string внутри counters, а индекс ссылается на них,
+    // поэтому вектор не должен переезжать
+    counters.reserve(maxCounters);
+    heap.reserve(maxCounters);
+    index.reserve(maxCounters);
+    sketch.assign(width * depth, 0);
+}
+
+void HeavyHitters::clear() {
+    counters.clear();
+    heap.clear();
+    index.clear();
+    std::fill(sketch.begin(), sketch.end(), 0);
+    totalCount = 0;
+}
+
+void HeavyHitters::add(std::string_view word, Count n) {
+    if (n <= 0) return;
+    totalCount += n;
+
+    const std::uint64_t wordHash = WordCountTable::hash(word);
+    if (width > 0) addToSketch(wordHash, n);
+
+    auto found = index.find(word);
+    if (found != index.end()) {
+        Counter &counter = counters[found->second];
+        counter.count += n;
+        siftDown(counter.heapPos);
+        return;
+    }
+
+    if (counters.size() < maxCounters) {
+        const std::uint32_t slot = static_cast<std::uint32_t>(counters.size());
+        counters.push_back({std::string(word), n, 0, heap.size()});
+        heap.push_back(slot);
+        index.emplace(counters.back().word, slot);
+        siftUp(heap.size() - 1);
+        return;
+    }
+
+    // вытесняем наименьший счётчик: новое слово могло встречаться не больше его значения раз
+    const std::uint32_t slot = heap[0];
+    Counter &counter = counters[slot];
+    index.erase(counter.word);
+    counter.word.assign(word.data(), word.size());
+    counter.error = counter.count;
+    counter.count += n;
+    index.emplace(counter.word, slot);
+    siftDown(0);
+}
+
+HeavyHitters::Count HeavyHitters::errorBound() const {
+    if (counters.size() < maxCounters) return 0;
+    return counters[heap[0]].count;
+}
+
+std::vector<HeavyHitters::Item> HeavyHitters::top(std::size_t k) const {
+    std::vector<Item> items;
+    items.reserve(counters.size());
+    for (const Counter &counter : counters) {
+        Count count = counter.count;
+        Count error = counter.error;
+        if (width > 0) {
+            // Count-Min тоже оценивает сверху, берём более точную из двух оценок
+            const Count estimate = sketchEstimate(WordCountTable::hash(counter.word));
+            if (estimate < count) {
+                error = std::max<Count>(0, error - (count - estimate));
+                count = estimate;
+            }
+        }
+        items.push_back({counter.word, count, error});
+    }
+
+    auto better = [](const Item &a, const Item &b) {
+        return a.count != b.count ? a.count > b.count : a.word < b.word;
+    };
+    const std::size_t n = std::min(k, items.size());
+    std::partial_sort(items.begin(), items.begin() + n, items.end(), better);
+    items.resize(n);
+    return items;
+}
+
+std::size_t HeavyHitters::memoryBytes() const {
+    std::size_t bytes = counters.capacity() * sizeof(Counter)
+        + heap.capacity() * sizeof(std::uint32_t)
+        + index.bucket_count() * sizeof(void *)
+        + index.size() * (sizeof(std::string_view) + sizeof(std::uint32_t) + 2 * sizeof(void *))
+        + sketch.capacity() * sizeof(Count);
+    for (const Counter &counter : counters) {
+        if (counter.word.capacity() > sizeof(std::string)) bytes += counter.word.capacity();
+    }
+    return bytes;
+}
+
+void HeavyHitters::swapHeap(std::size_t a, std::size_t b) {
+    std::swap(heap[a], heap[b]);
+    counters[heap[a]].heapPos = a;
+    counters[heap[b]].heapPos = b;
+}
+
+void HeavyHitters::siftUp(std::size_t pos) {
+    while (pos > 0) {
+        const std::size_t parent = (pos - 1) / 2;
+        if (counters[heap[parent]].count <= counters[heap[pos]].count) break;
+        swapHeap(pos, parent);
+        pos = parent;
+    }
+}
+
+void HeavyHitters::siftDown(std::size_t pos) {
+    while (true) {
+        const std::size_t left = 2 * pos + 1;
+        const std::size_t right = left + 1;
+        std::size_t smallest = pos;
+        if (left < heap.size() && counters[heap[left]].count < counters[heap[smallest]].count) smallest = left;
+        if (right < heap.size() && counters[heap[right]].count < counters[heap[smallest]].count) smallest = right;
+        if (smallest == pos) break;
+        swapHeap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void HeavyHitters::addToSketch(std::uint64_t wordHash, Count n) {
+    const std::uint64_t step = (wordHash >> 32) | 1;
+    for (std::size_t row = 0; row < depth; row++) {
+        sketch[row * width + (wordHash + row * step) % width] += n;
+    }
+}
+
+HeavyHitters::Count HeavyHitters::sketchEstimate(std::uint64_t wordHash) const {
+    const std::uint64_t step = (wordHash >> 32) | 1;
+    Count estimate = sketch[(wordHash) % width];
+    for (std::size_t row = 1; row < depth; row++) {
+        estimate = std::min(estimate, sketch[row * width + (wordHash + row * step) % width]);
+    }
+    return estimate;
+}
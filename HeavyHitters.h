@@ -0,0 +1,70 @@
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Приближённый подсчёт самых частых слов с фиксированной памятью (Space-Saving).
+// Отслеживается не больше capacity слов; счётчик слова завышен не больше чем на его error,
+// а любое слово с частотой больше total() / capacity гарантированно отслеживается.
+// Если задана ширина sketchWidth, оценки дополнительно уточняются сверху скетчем Count-Min.
+class HeavyHitters {
+public:
+    using Count = std::int64_t;
+
+    struct Item {
+        std::string_view word;
+        Count count;   // верхняя оценка частоты
+        Count error;   // count - error - нижняя оценка
+    };
+
+    explicit HeavyHitters(std::size_t capacity, std::size_t sketchWidth = 0, std::size_t sketchDepth = 4);
+    // индекс ссылается на строки внутри counters, поэтому копировать нельзя
+    HeavyHitters(const HeavyHitters &) = delete;
+    HeavyHitters &operator=(const HeavyHitters &) = delete;
+    HeavyHitters(HeavyHitters &&) = default;
+    HeavyHitters &operator=(HeavyHitters &&) = default;
+
+    void add(std::string_view word, Count n = 1);
+    void clear();
+
+    // k самых частых слов по убыванию оценки, при равенстве по алфавиту
+    std::vector<Item> top(std::size_t k) const;
+
+    std::size_t size() const { return counters.size(); }
+    std::size_t capacity() const { return maxCounters; }
+    Count total() const { return totalCount; }
+    // наибольшее возможное завышение частоты любого слова
+    Count errorBound() const;
+    std::size_t memoryBytes() const;
+
+private:
+    struct Counter {
+        std::string word;
+        Count count;
+        Count error;
+        std::size_t heapPos;
+    };
+
+    std::size_t maxCounters;
+    std::size_t width;
+    std::size_t depth;
+    Count totalCount = 0;
+
+    std::vector<Counter> counters;
+    std::vector<std::uint32_t> heap;  // индексы counters, на вершине наименьший счётчик
+    std::unordered_map<std::string_view, std::uint32_t> index;
+    std::vector<Count> sketch;
+
+    void siftDown(std::size_t pos);
+    void siftUp(std::size_t pos);
+    void swapHeap(std::size_t a, std::size_t b);
+    void addToSketch(std::uint64_t wordHash, Count n);
+    Count sketchEstimate(std::uint64_t wordHash) const;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "IdfIndex.h"
+#include "WordCloudGenerator.h"
+#include <QDebug>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+bool IdfIndex::open(const QString &path) {
+    documentCount = 0;
+    if (!snapshot.open(path)) return false;
+
+    if (snapshot.size() == 0 || !snapshot.word(0).empty() || snapshot.count(0) < 1) {
+        snapshot.close();
+        return false;
+    }
+    documentCount = snapshot.count(0);
+    return true;
+}
+
+double IdfIndex::idf(std::string_view word) const {
+    CountSnapshot::Count df = 0;
+    snapshot.find(word, df);
+    return std::log((1.0 + documentCount) / (1.0 + df)) + 1.0;
+}
+
+bool IdfIndex::build(const QStringList &files, const QString &output, const TokenNormalizer &normalizer,
+                     int threads) {
+    std::atomic<qsizetype> next{0};
+    std::atomic<bool> failed{false};
+    std::vector<WordCountTable> shards(std::max(1, std::min<int>(threads, static_cast<int>(files.size()))));
+
+    // документы разбираются по одному; у потока свой генератор и своя таблица частот документов
+    auto worker = [&](size_t t) {
+        WordCloudGenerator generator;
+        generator.setNormalizer(normalizer);
+        for (qsizetype i = next++; i < files.size() && !failed; i = next++) {
+            generator.clear();
+            if (!generator.processFile(files.at(i))) {
+                qCritical() << "Error: Can`t read file" << files.at(i);
+                failed = true;
+                break;
+            }
+            generator.frequencies().forEach([&](std::string_view word, WordCountTable::Count) {
+                shards[t].add(word);
+            });
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < shards.size(); t++) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto &thread : pool) {
+        thread.join();
+    }
+    if (failed) return false;
+
+    WordCountTable &df = shards[0];
+    for (size_t t = 1; t < shards.size(); t++) {
+        shards[t].forEach([&](std::string_view word, WordCountTable::Count n) { df.add(word, n); });
+    }
+    df.add("", files.size());
+
+    if (!CountSnapshot::save(output, df)) {
+        qCritical() << "Error: Can`t save the index" << output;
+        return false;
+    }
+    return true;
+}
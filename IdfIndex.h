@@ -0,0 +1,31 @@
+#ifndef IDFINDEX_H
+#define IDFINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <string_view>
+#include "CountSnapshot.h"
+#include "TokenNormalizer.h"
+
+// Документные частоты эталонного корпуса для весов TF-IDF.
+// Файл - обычный снимок частот (CountSnapshot): частота слова - число документов, где оно есть,
+// а пустое слово (оно всегда первое) хранит число документов. Поэтому индексы, построенные
+// по частям корпуса, сливаются той же командой merge, а открытие - только mmap без разбора.
+class IdfIndex {
+public:
+    bool open(const QString &path);
+
+    qint64 documents() const { return documentCount; }
+    // Сглаженный idf = ln((1 + N) / (1 + df)) + 1: не меньше 1, у незнакомых слов наибольший.
+    double idf(std::string_view word) const;
+
+    // Каждый файл - отдельный документ; слова проходят через normalizer, как при рисовании.
+    static bool build(const QStringList &files, const QString &output, const TokenNormalizer &normalizer,
+                      int threads);
+
+private:
+    CountSnapshot snapshot;
+    qint64 documentCount = 0;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "ImageMask.h"
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const char MAGIC[8] = {'W', 'C', 'M', 'A', 'S', 'K', 'D', 'F'};
+constexpr size_t HEADER_SIZE = 24;
+constexpr double FAR = 1e20;
+
+// Квадраты расстояний вдоль строки или столбца (Felzenszwalb, Huttenlocher): нижняя огибающая
+// парабол с вершинами в f, за O(n). v и z - рабочие массивы на n и n + 1 элементов.
+void distanceLine(const double *f, int n, double *d, int *v, double *z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -FAR;
+    z[1] = FAR;
+    for (int q = 1; q < n; q++) {
+        double s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+        while (s <= z[k]) {
+            k--;
+            s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = FAR;
+    }
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        d[q] = double(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+}
+
+bool ImageMask::load(const QString &path) {
+    QImage image;
+    if (!image.load(path)) return false;
+    return fromImage(std::move(image));
+}
+
+bool ImageMask::fromImage(QImage image) {
+    if (image.isNull()) return false;
+    if (image.width() > RESOLUTION || image.height() > RESOLUTION) {
+        image = image.scaled(RESOLUTION, RESOLUTION, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    const bool alpha = image.hasAlphaChannel();
+    image = image.convertToFormat(QImage::Format_ARGB32);
+
+    maskWidth = image.width();
+    maskHeight = image.height();
+    std::vector<char> covered(static_cast<size_t>(maskWidth) * maskHeight);
+    bool any = false;
+    for (int y = 0; y < maskHeight; y++) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < maskWidth; x++) {
+            const bool in = alpha ? qAlpha(line[x]) >= 128 : qGray(line[x]) < 128;
+            covered[static_cast<size_t>(y) * maskWidth + x] = in;
+            any = any || in;
+        }
+    }
+    if (!any) return false;
+
+    computeDistances(covered);
+    buildIntegral();
+    findCenters();
+    return true;
+}
+
+void ImageMask::computeDistances(const std::vector<char> &covered) {
+    const int w = maskWidth;
+    const int h = maskHeight;
+    const int n = std::max(w, h);
+    std::vector<double> grid(covered.size());
+    std::vector<double> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+
+    for (size_t i = 0; i < covered.size(); i++) grid[i] = covered[i] ? FAR : 0;
+    // сначала по столбцам, потом по строкам: сумма квадратов разделяется по осям
+    for (int x = 0; x < w; x++) {
+        for (int y = 0; y < h; y++) f[y] = grid[static_cast<size_t>(y) * w + x];
+        distanceLine(f.data(), h, d.data(), v.data(), z.data());
+        for (int y = 0; y < h; y++) grid[static_cast<size_t>(y) * w + x] = d[y];
+    }
+    for (int y = 0; y < h; y++) {
+        double *row = grid.data() + static_cast<size_t>(y) * w;
+        std::copy(row, row + w, f.begin());
+        distanceLine(f.data(), w, row, v.data(), z.data());
+    }
+
+    // за краем картинки маски нет: расстояние не больше, чем до края
+    distances.assign(covered.size(), 0);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const size_t i = static_cast<size_t>(y) * w + x;
+            if (!covered[i]) continue;
+            const double edge = std::min({x + 1, y + 1, w - x, h - y});
+            const double distance = std::min(std::sqrt(grid[i]), edge);
+            distances[i] = static_cast<std::uint16_t>(std::lround(distance * DISTANCE_SCALE));
+        }
+    }
+}
+
+void ImageMask::buildIntegral() {
+    const size_t stride = static_cast<size_t>(maskWidth) + 1;
+    outside.assign(stride * (maskHeight + 1), 0);
+    for (int y = 0; y < maskHeight; y++) {
+        std::uint32_t row = 0;
+        for (int x = 0; x < maskWidth; x++) {
+            row += distances[static_cast<size_t>(y) * maskWidth + x] == 0;
+            outside[(y + 1) * stride + x + 1] = outside[y * stride + x + 1] + row;
+        }
+    }
+}
+
+bool ImageMask::inside(int x0, int y0, int x1, int y1) const {
+    if (x0 < 0 || y0 < 0 || x1 > maskWidth || y1 > maskHeight || x0 >= x1 || y0 >= y1) return false;
+    const size_t stride = static_cast<size_t>(maskWidth) + 1;
+    return outside[y1 * stride + x1] - outside[y0 * stride + x1] - outside[y1 * stride + x0]
+        + outside[y0 * stride + x0] == 0;
+}
+
+void ImageMask::findCenters() {
+    centers.clear();
+    auto at = [this](int x, int y) -> int {
+        if (x < 0 || y < 0 || x >= maskWidth || y >= maskHeight) return 0;
+        return distances[static_cast<size_t>(y) * maskWidth + x];
+    };
+
+    // хребет поля расстояний: точка не ниже обоих соседей хотя бы по одному из четырёх направлений
+    std::vector<Center> ridge;
+    for (int y = 0; y < maskHeight; y++) {
+        for (int x = 0; x < maskWidth; x++) {
+            const int d = at(x, y);
+            if (d == 0) continue;
+            if ((d >= at(x - 1, y) && d >= at(x + 1, y)) || (d >= at(x, y - 1) && d >= at(x, y + 1))
+                || (d >= at(x - 1, y - 1) && d >= at(x + 1, y + 1)) || (d >= at(x + 1, y - 1) && d >= at(x - 1, y + 1))) {
+                ridge.push_back({static_cast<std::uint16_t>(x), static_cast<std::uint16_t>(y), static_cast<std::uint16_t>(d)});
+            }
+        }
+    }
+    std::stable_sort(ridge.begin(), ridge.end(), [](const Center &a, const Center &b) { return a.radius > b.radius; });
+
+    // Жадная укладка кругов: точка берётся, если не попадает в круги уже взятых.
+    // Когда широкие места кончились, круги сжимаются, и центры ставятся плотнее.
+    for (double spacing : {1.0, 0.5, 0.25}) {
+        for (const Center &candidate : ridge) {
+            if (centers.size() >= MAX_CENTERS) return;
+            bool free = true;
+            for (const Center &center : centers) {
+                const double dx = double(candidate.x) - center.x;
+                const double dy = double(candidate.y) - center.y;
+                const double reach = std::max(2.0, spacing * std::max(candidate.radius, center.radius) / DISTANCE_SCALE);
+                if (dx * dx + dy * dy < reach * reach) {
+                    free = false;
+                    break;
+                }
+            }
+            if (free) centers.push_back(candidate);
+        }
+    }
+}
+
+ImageMask::Fit ImageMask::fitTo(int canvasWidth, int canvasHeight) const {
+    const double scale = std::min(double(canvasWidth) / maskWidth, double(canvasHeight) / maskHeight);
+    return {scale, (canvasWidth - maskWidth * scale) / 2, (canvasHeight - maskHeight * scale) / 2};
+}
+
+void ImageMask::anchors(int count, const QSize &size, std::vector<QPoint> &positions) const {
+    if (centers.empty()) return;
+    const Fit fit = fitTo(size.width(), size.height());
+    positions.reserve(positions.size() + count);
+    // слов больше, чем центров: лишние начинают с уже занятых мест, WordPlacer сдвинет их к свободным
+    for (int i = 0; i < count; i++) {
+        const Center &center = centers[i % centers.size()];
+        positions.push_back(QPoint(static_cast<int>(fit.offsetX + (center.x + 0.5) * fit.scale),
+                                   static_cast<int>(fit.offsetY + (center.y + 0.5) * fit.scale)));
+    }
+}
+
+void ImageMask::blockOutside(WordPlacer &placer) const {
+    const int cell = placer.cellSize();
+    const Fit fit = fitTo(placer.width(), placer.height());
+
+    // клетка холста переводится в пиксели маски, её проверка - одно обращение к интегральной картинке;
+    // подряд идущие занятые клетки строки занимаются одним прямоугольником
+    for (int y = 0; y < placer.height(); y += cell) {
+        const int y0 = static_cast<int>(std::floor((y - fit.offsetY) / fit.scale));
+        const int y1 = static_cast<int>(std::ceil((y + cell - fit.offsetY) / fit.scale));
+        int blockedFrom = -1;
+        for (int x = 0; x < placer.width(); x += cell) {
+            const int x0 = static_cast<int>(std::floor((x - fit.offsetX) / fit.scale));
+            const int x1 = static_cast<int>(std::ceil((x + cell - fit.offsetX) / fit.scale));
+            const bool blocked = !inside(x0, y0, x1, y1);
+            if (blocked && blockedFrom < 0) {
+                blockedFrom = x;
+            } else if (!blocked && blockedFrom >= 0) {
+                placer.occupy({blockedFrom, y, x - blockedFrom, cell});
+                blockedFrom = -1;
+            }
+        }
+        if (blockedFrom >= 0) placer.occupy({blockedFrom, y, placer.width() - blockedFrom, cell});
+    }
+}
+
+QByteArray ImageMask::toBytes() const {
+    QByteArray bytes(HEADER_SIZE + distances.size() * 2 + centers.size() * 6, '\0');
+    char *data = bytes.data();
+    std::memcpy(data, MAGIC, sizeof(MAGIC));
+    qToLittleEndian<quint32>(VERSION, data + 8);
+    qToLittleEndian<quint32>(maskWidth, data + 12);
+    qToLittleEndian<quint32>(maskHeight, data + 16);
+    qToLittleEndian<quint32>(static_cast<quint32>(centers.size()), data + 20);
+    data += HEADER_SIZE;
+    qToLittleEndian<quint16>(distances.data(), qsizetype(distances.size()), data);
+    data += distances.size() * 2;
+    for (const Center &center : centers) {
+        qToLittleEndian<quint16>(center.x, data);
+        qToLittleEndian<quint16>(center.y, data + 2);
+        qToLittleEndian<quint16>(center.radius, data + 4);
+        data += 6;
+    }
+    return bytes;
+}
+
+bool ImageMask::fromBytes(const QByteArray &bytes) {
+    if (bytes.size() < qsizetype(HEADER_SIZE)) return false;
+    const char *data = bytes.constData();
+    const std::uint32_t w = qFromLittleEndian<quint32>(data + 12);
+    const std::uint32_t h = qFromLittleEndian<quint32>(data + 16);
+    const std::uint32_t count = qFromLittleEndian<quint32>(data + 20);
+    const bool fits = std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0
+        && qFromLittleEndian<quint32>(data + 8) == VERSION
+        && w >= 1 && h >= 1 && w <= RESOLUTION && h <= RESOLUTION && count >= 1 && count <= MAX_CENTERS
+        && std::uint64_t(bytes.size()) == HEADER_SIZE + std::uint64_t(w) * h * 2 + count * 6;
+    if (!fits) return false;
+
+    maskWidth = static_cast<int>(w);
+    maskHeight = static_cast<int>(h);
+    data += HEADER_SIZE;
+    distances.resize(static_cast<size_t>(w) * h);
+    qFromLittleEndian<quint16>(data, qsizetype(distances.size()), distances.data());
+    data += distances.size() * 2;
+    centers.resize(count);
+    for (Center &center : centers) {
+        center.x = qFromLittleEndian<quint16>(data);
+        center.y = qFromLittleEndian<quint16>(data + 2);
+        center.radius = qFromLittleEndian<quint16>(data + 4);
+        if (center.x >= w || center.y >= h) return false;
+        data += 6;
+    }
+    buildIntegral();
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef IMAGEMASK_H
+#define IMAGEMASK_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <cstdint>
+#include <vector>
+#include "WordPlacer.h"
+
+// Форма облака из картинки: слова ставятся только на непрозрачные пиксели (у картинки без
+// альфа-канала - на тёмные). Картинка один раз уменьшается до RESOLUTION и превращается в поле
+// расстояний до края (евклидово преобразование расстояний) и интегральную картинку пикселей вне маски:
+// проверка, что прямоугольник целиком внутри, - четыре чтения. По хребту поля расстояний выбираются
+// центры слов от самых широких мест к узким, так что крупные слова попадают туда, где им хватает места.
+// Маска вписывается в холст с сохранением пропорций. toBytes/fromBytes сохраняют обработанную
+// маску, чтобы повторные запуски с той же картинкой брали её из кэша.
+class ImageMask {
+public:
+    bool load(const QString &path);
+    // false, если в картинке нет ни одного пикселя маски
+    bool fromImage(QImage image);
+
+    QByteArray toBytes() const;
+    bool fromBytes(const QByteArray &bytes);
+
+    int width() const { return maskWidth; }
+    int height() const { return maskHeight; }
+    // расстояние в пикселях маски от (x, y) до ближайшего пикселя вне её; 0 - вне маски
+    double distance(int x, int y) const { return distances[static_cast<size_t>(y) * maskWidth + x] / double(DISTANCE_SCALE); }
+    // все пиксели [x0, x1) x [y0, y1) внутри маски (и картинки)
+    bool inside(int x0, int y0, int x1, int y1) const;
+
+    // Желаемые центры count слов на холсте size, по убыванию свободного места вокруг.
+    void anchors(int count, const QSize &size, std::vector<QPoint> &positions) const;
+    // Занимает в placer все клетки, которые не лежат целиком внутри маски.
+    void blockOutside(WordPlacer &placer) const;
+
+    static constexpr int RESOLUTION = 512;
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr int MAX_WORDS = 60;
+    static constexpr int BASE_FONT_SIZE = 12;
+    static constexpr int FONT_MULTIPLIER = 20;
+
+private:
+    struct Center {
+        std::uint16_t x;
+        std::uint16_t y;
+        std::uint16_t radius;  // в единицах DISTANCE_SCALE
+    };
+    struct Fit {
+        double scale;
+        double offsetX;
+        double offsetY;
+    };
+
+    static constexpr int DISTANCE_SCALE = 8;
+    static constexpr size_t MAX_CENTERS = 1024;
+
+    int maskWidth = 0;
+    int maskHeight = 0;
+    std::vector<std::uint16_t> distances;  // в 1/DISTANCE_SCALE пикселя
+    std::vector<std::uint32_t> outside;    // (width + 1) x (height + 1), число пикселей вне маски левее и выше
+    std::vector<Center> centers;
+
+    void computeDistances(const std::vector<char> &covered);
+    void buildIntegral();
+    void findCenters();
+    Fit fitTo(int canvasWidth, int canvasHeight) const;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "ImageOutput.h"
+#include "Layout.h"
+#include "Profiler.h"
+#include "TiledRenderer.h"
+#include <QIODevice>
+#include <QImage>
+#include <QImageWriter>
+#include <QtEndian>
+
+namespace {
+
+struct FormatName {
+    const char *name;
+    OutputFormat format;
+};
+
+// первое имя формата - его расширение
+const FormatName FORMAT_NAMES[] = {
+    {"jpg", OutputFormat::Jpeg}, {"jpeg", OutputFormat::Jpeg}, {"png", OutputFormat::Png},
+    {"bmp", OutputFormat::Bmp},  {"raw", OutputFormat::Raw},   {"bgra", OutputFormat::Raw},
+    {"svg", OutputFormat::Svg},  {"pdf", OutputFormat::Pdf},
+};
+
+// ARGB32 хранит пиксель как число 0xAARRGGBB, в little-endian это байты B, G, R, A
+bool writeBgra(const QImage &image, QIODevice &device) {
+    QByteArray row(static_cast<qsizetype>(image.width()) * 4, '\0');
+    for (int line = 0; line < image.height(); line++) {
+        qToLittleEndian<quint32>(image.constScanLine(line), image.width(), row.data());
+        if (device.write(row) != row.size()) return false;
+    }
+    return true;
+}
+
+}
+
+bool outputFormatFromName(const QString &name, OutputFormat &format) {
+    for (const FormatName &entry : FORMAT_NAMES) {
+        if (name.compare(QLatin1String(entry.name), Qt::CaseInsensitive) == 0) {
+            format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString outputFormatExtension(OutputFormat format) {
+    for (const FormatName &entry : FORMAT_NAMES) {
+        if (entry.format == format) return QString::fromLatin1(entry.name);
+    }
+    return QString();
+}
+
+bool writeImage(const Layout &layout, const QSize &size, const ImageOptions &options, QIODevice &device,
+                GlyphCache *cache) {
+    if (options.format == OutputFormat::Svg) {
+        Profiler::Scope scope(Profiler::Stage::Encode);
+        const QByteArray svg = layout.toSvg(size);
+        return device.write(svg) == svg.size();
+    }
+    if (options.format == OutputFormat::Pdf) {
+        Profiler::Scope scope(Profiler::Stage::Encode);
+        return layout.writePdf(&device, size);
+    }
+
+    if (options.tileSize > 0) {
+        const TiledRenderer tiles(layout, size, options.tileSize, options.threads);
+        if (options.format == OutputFormat::Bmp) return tiles.writeBmp(device);
+        if (options.format == OutputFormat::Raw) {
+            return tiles.render([&device](const QImage &band, int) { return writeBgra(band, device); });
+        }
+        // JPEG и PNG кодируются только из целой картинки
+        return false;
+    }
+
+    return writeRaster(layout.toImage(size, cache), options, device);
+}
+
+bool writeRaster(const QImage &image, const ImageOptions &options, QIODevice &device) {
+    Profiler::Scope scope(Profiler::Stage::Encode);
+
+    if (options.format == OutputFormat::Raw) return writeBgra(image, device);
+
+    QImageWriter writer(&device, options.format == OutputFormat::Png   ? "png"
+                                 : options.format == OutputFormat::Bmp ? "bmp"
+                                                                       : "jpg");
+    if (options.format == OutputFormat::Jpeg) {
+        writer.setQuality(100);
+    } else if (options.format == OutputFormat::Png && options.pngLevel >= 0) {
+        // Qt переводит качество 0-100 в уровень zlib как (100 - quality) * 9 / 91
+        writer.setQuality(100 - (options.pngLevel * 91 + 8) / 9);
+    }
+    return writer.write(image);
+}
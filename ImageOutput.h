@@ -0,0 +1,34 @@
+#ifndef IMAGEOUTPUT_H
+#define IMAGEOUTPUT_H
+
+#include <QSize>
+#include <QString>
+
+class GlyphCache;
+class QIODevice;
+class QImage;
+struct Layout;
+
+// Формат выходного файла. Растровые форматы рисуются через QImage (BMP и Raw ещё и плитками),
+// SVG и PDF пишутся прямо из раскладки, без растра.
+enum class OutputFormat { Jpeg, Png, Bmp, Raw, Svg, Pdf };
+
+struct ImageOptions {
+    OutputFormat format = OutputFormat::Jpeg;
+    int pngLevel = -1;  // сжатие PNG 0-9 как у zlib, -1 - по умолчанию Qt
+    int tileSize = 0;   // больше 0 - растр рисуется плитками (TiledRenderer), годится для BMP и Raw
+    int threads = 1;
+};
+
+// Формат по имени или расширению: jpg, jpeg, png, bmp, raw, bgra, svg, pdf; регистр не важен.
+bool outputFormatFromName(const QString &name, OutputFormat &format);
+// Основное расширение формата без точки.
+QString outputFormatExtension(OutputFormat format);
+
+// Пишет раскладку в размере size в device. Raw - строки пикселей BGRA сверху вниз, без заголовка.
+bool writeImage(const Layout &layout, const QSize &size, const ImageOptions &options, QIODevice &device,
+                GlyphCache *cache = nullptr);
+// Кодирует готовую картинку в растровый формат options (jpg, png, bmp или raw).
+bool writeRaster(const QImage &image, const ImageOptions &options, QIODevice &device);
+
+#endif
@@ -0,0 +1,309 @@
+#include "Ingest.h"
+#include "Profiler.h"
+#include "Utf8Tokenizer.h"
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <vector>
+
+QStringList IngestStats::summary() const {
+    auto rate = [](double amount, qint64 ns, int threads) {
+        // время стадии - сумма по её потокам, поэтому делим на среднее время одного потока
+        return ns > 0 ? amount * threads / (ns / 1e9) : 0.0;
+    };
+    auto share = [](qint64 waitNs, qint64 busyNs) {
+        return waitNs + busyNs > 0 ? 100.0 * waitNs / (waitNs + busyNs) : 0.0;
+    };
+    const double mb = bytes / 1e6;
+
+    return {
+        QString("Read: %1 files, %2 MB on %3 threads - %4 MB/s, %5 files/s, waited for workers %6%")
+            .arg(files).arg(mb, 0, 'f', 1).arg(readers)
+            .arg(rate(mb, readNs, readers), 0, 'f', 1).arg(rate(files, readNs, readers), 0, 'f', 0)
+            .arg(share(readWaitNs, readNs), 0, 'f', 0),
+        QString("Count: %1 buffers on %2 threads - %3 MB/s, %4 files/s, waited for readers %5%")
+            .arg(buffers).arg(workers)
+            .arg(rate(mb, countNs, workers), 0, 'f', 1).arg(rate(files, countNs, workers), 0, 'f', 0)
+            .arg(share(countWaitNs, countNs), 0, 'f', 0),
+        QString("Total: %1 s - %2 MB/s, %3 files/s")
+            .arg(wallNs / 1e9, 0, 'f', 2)
+            .arg(rate(mb, wallNs, 1), 0, 'f', 1).arg(rate(files, wallNs, 1), 0, 'f', 0),
+    };
+}
+
+bool collectInputFiles(const QStringList &inputs, QStringList &files) {
+    for (const QString &input : inputs) {
+        if (input.startsWith('@')) {
+            const QString listPath = input.mid(1);
+            QFile list(listPath);
+
+            if (!list.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                qCritical() << "Error: Can`t open file list" << listPath;
+                return false;
+            }
+
+            const QDir base = QFileInfo(listPath).dir();
+            while (!list.atEnd()) {
+                const QString line = QString::fromUtf8(list.readLine()).trimmed();
+                if (!line.isEmpty()) files.append(base.filePath(line));
+            }
+            continue;
+        }
+
+        const QFileInfo info(input);
+
+        if (info.isDir()) {
+            QStringList found;
+            QDirIterator it(input, {"*.txt"}, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) found.append(it.next());
+            found.sort();
+            files.append(found);
+            continue;
+        }
+
+        if (input.contains('*') || input.contains('?') || input.contains('[')) {
+            const QDir dir = info.dir();
+            const QStringList names = dir.entryList({info.fileName()}, QDir::Files, QDir::Name);
+
+            if (names.isEmpty()) {
+                qCritical() << "Error: No files match" << input;
+                return false;
+            }
+
+            for (const QString &name : names) files.append(dir.filePath(name));
+            continue;
+        }
+
+        if (!input.endsWith(".txt", Qt::CaseInsensitive)) {
+            qCritical() << "Error: Input file must have .txt extension";
+            qCritical() << "Got:" << input;
+            return false;
+        }
+        files.append(input);
+    }
+
+    if (files.isEmpty()) {
+        qCritical() << "Error: No input files found";
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+qint64 nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Batch {
+    QByteArray data;
+    qsizetype size = 0;
+};
+
+// Очередь фиксированной ёмкости: push ждёт места, pop ждёт буфера или закрытия очереди.
+class BatchQueue {
+public:
+    explicit BatchQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(Batch batch) {
+        QMutexLocker lock(&mutex);
+        while (items.size() >= capacity) notFull.wait(&mutex);
+        items.push_back(std::move(batch));
+        notEmpty.wakeOne();
+    }
+
+    bool pop(Batch &batch) {
+        QMutexLocker lock(&mutex);
+        while (items.empty() && !closed) notEmpty.wait(&mutex);
+        if (items.empty()) return false;
+        batch = std::move(items.front());
+        items.pop_front();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void close() {
+        QMutexLocker lock(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+    }
+
+    // отработанные буферы возвращаются читателям, чтобы не выделять по 4 МБ на каждый
+    void recycle(QByteArray buffer) {
+        QMutexLocker lock(&mutex);
+        if (spare.size() < capacity) spare.push_back(std::move(buffer));
+    }
+
+    QByteArray takeBuffer(qint64 size) {
+        QMutexLocker lock(&mutex);
+        QByteArray buffer;
+        if (!spare.empty()) {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        }
+        lock.unlock();
+        if (buffer.size() < size) buffer.resize(size);
+        return buffer;
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notFull;
+    QWaitCondition notEmpty;
+    std::deque<Batch> items;
+    std::vector<QByteArray> spare;
+    size_t capacity;
+    bool closed = false;
+};
+
+}
+
+bool ingestFiles(const QStringList &files, const IngestOptions &options, const IngestConsumer &consume,
+                 IngestStats &stats) {
+    const qint64 wallStart = nowNs();
+    const int workers = std::max(1, options.workers);
+    const int readers = std::max(1, std::min<int>(options.readers, static_cast<int>(files.size())));
+    const qint64 batchBytes = std::max<qint64>(options.batchBytes, 64);
+    BatchQueue queue(options.queueBuffers > 0 ? options.queueBuffers : 2 * workers);
+
+    std::atomic<qsizetype> next{0};
+    std::atomic<bool> failed{false};
+    std::atomic<qint64> fileCount{0}, byteCount{0}, bufferCount{0};
+    std::atomic<qint64> readNs{0}, readWaitNs{0}, countNs{0}, countWaitNs{0};
+
+    auto reader = [&]() {
+        QByteArray buffer = queue.takeBuffer(batchBytes);
+        qsizetype filled = 0;
+        qint64 waited = 0;
+        const qint64 started = nowNs();
+
+        // отправляет буфер до последнего разделителя, хвост (начало слова) переносит в новый
+        auto flush = [&]() {
+            qsizetype cut = filled;
+            while (cut > 0 && !Utf8Tokenizer::isSeparator(buffer.at(cut - 1))) cut--;
+            if (cut == 0) {
+                // в буфере ни одного разделителя - слово длиннее буфера
+                buffer.resize(buffer.size() * 2);
+                return;
+            }
+
+            QByteArray rest = queue.takeBuffer(std::max<qint64>(batchBytes, filled - cut));
+            std::memcpy(rest.data(), buffer.constData() + cut, filled - cut);
+            const qint64 waitStart = nowNs();
+            queue.push({std::move(buffer), cut});
+            waited += nowNs() - waitStart;
+            bufferCount++;
+            buffer = std::move(rest);
+            filled -= cut;
+        };
+
+        for (qsizetype i = next++; i < files.size() && !failed; i = next++) {
+            Profiler::Scope scope(Profiler::Stage::Read);
+            QFile file(files.at(i));
+
+            // без буфера QFile байты читаются сразу в наш буфер
+            if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+                qCritical() << "Error: Can`t open file" << files.at(i);
+                failed = true;
+                break;
+            }
+
+            qint64 fileBytes = 0;
+            while (true) {
+                if (filled == buffer.size()) flush();
+                const qint64 n = file.read(buffer.data() + filled, buffer.size() - filled);
+                if (n < 0) {
+                    qCritical() << "Error: Can`t read file" << files.at(i);
+                    failed = true;
+                    break;
+                }
+                if (n == 0) break;
+                filled += n;
+                fileBytes += n;
+            }
+            if (failed) break;
+
+            // перевод строки не даёт последнему слову файла слиться с первым словом следующего
+            if (filled == buffer.size()) buffer.resize(buffer.size() + 1);
+            buffer[filled++] = '\n';
+
+            fileCount++;
+            byteCount += fileBytes;
+            Profiler::add(Profiler::Counter::BytesRead, fileBytes);
+            Profiler::add(Profiler::Counter::Files);
+            // мелкие файлы копятся в одном буфере, он уходит, только когда заполнится
+            if (filled >= batchBytes) flush();
+        }
+
+        if (filled > 0 && !failed) {
+            const qint64 waitStart = nowNs();
+            queue.push({std::move(buffer), filled});
+            waited += nowNs() - waitStart;
+            bufferCount++;
+        }
+        // работа читателя - всё, кроме ожидания очереди
+        readNs += nowNs() - started - waited;
+        readWaitNs += waited;
+    };
+
+    auto worker = [&](int index) {
+        qint64 busy = 0;
+        qint64 waited = 0;
+        Batch batch;
+
+        while (true) {
+            const qint64 waitStart = nowNs();
+            if (!queue.pop(batch)) break;
+            const qint64 start = nowNs();
+            waited += start - waitStart;
+
+            // после ошибки буферы только выбираются, чтобы читатели не застряли на полной очереди
+            if (!failed) consume(index, batch.data.data(), batch.size);
+            queue.recycle(std::move(batch.data));
+            busy += nowNs() - start;
+        }
+        countNs += busy;
+        countWaitNs += waited;
+    };
+
+    std::vector<std::thread> workerThreads;
+    for (int t = 0; t < workers; t++) {
+        workerThreads.emplace_back(worker, t);
+    }
+    std::vector<std::thread> readerThreads;
+    for (int t = 0; t < readers; t++) {
+        readerThreads.emplace_back(reader);
+    }
+    for (auto &thread : readerThreads) {
+        thread.join();
+    }
+    queue.close();
+    for (auto &thread : workerThreads) {
+        thread.join();
+    }
+
+    stats.readers = readers;
+    stats.workers = workers;
+    stats.files = fileCount;
+    stats.bytes = byteCount;
+    stats.buffers = bufferCount;
+    stats.readNs = readNs;
+    stats.readWaitNs = readWaitNs;
+    stats.countNs = countNs;
+    stats.countWaitNs = countWaitNs;
+    stats.wallNs = nowNs() - wallStart;
+    return !failed;
+}
@@ -0,0 +1,51 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// Чтение корпуса из многих файлов. Потоки-читатели собирают файлы в буферы по batchBytes
+// (мелкие файлы - по нескольку в буфер, крупные - частями) и кладут их в ограниченную очередь,
+// обработчики забирают буферы и считают слова. Каждый буфер кончается на разделителе,
+// поэтому слово никогда не делится между буферами, а между файлами вставляется перевод строки.
+struct IngestOptions {
+    int readers = 4;
+    int workers = 1;
+    qint64 batchBytes = 4 << 20;
+    int queueBuffers = 0;  // 0 - по два буфера на обработчика
+};
+
+struct IngestStats {
+    int readers = 0;
+    int workers = 0;
+    qint64 files = 0;
+    qint64 bytes = 0;
+    qint64 buffers = 0;
+    // время суммируется по потокам стадии: работа и ожидание очереди
+    qint64 readNs = 0;
+    qint64 readWaitNs = 0;   // читатели ждали места в очереди - не успевают обработчики
+    qint64 countNs = 0;
+    qint64 countWaitNs = 0;  // обработчики ждали буферов - не успевает диск
+    qint64 wallNs = 0;
+
+    // Пропускная способность стадий (МБ/с, файлов/с) в виде строк для вывода.
+    QStringList summary() const;
+};
+
+// Раскрывает аргументы командной строки в список файлов:
+//   папка       - все *.txt в ней и во вложенных папках;
+//   маска       - файлы по маске в имени (data/*.txt, part-??.log), папка маской быть не может;
+//   @список     - файл со списком путей, по одному на строку, относительные - от папки списка;
+//   иначе       - сам файл, он должен иметь расширение .txt.
+// Папки и маски раскрываются по алфавиту, чтобы порядок (и ключ кэша) не зависел от файловой системы.
+bool collectInputFiles(const QStringList &inputs, QStringList &files);
+
+// Обработчик буфера: номер обработчика (0..workers-1) и байты, которые можно менять на месте.
+using IngestConsumer = std::function<void(int worker, char *data, qsizetype size)>;
+
+// Прогоняет files через очередь; возвращает false, если какой-то файл не удалось прочитать.
+bool ingestFiles(const QStringList &files, const IngestOptions &options, const IngestConsumer &consume,
+                 IngestStats &stats);
+
+#endif
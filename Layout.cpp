@@ -0,0 +1,177 @@
+#include "Layout.h"
+#include "GlyphCache.h"
+#include "Profiler.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QRegion>
+#include <algorithm>
+
+void Layout::render(QPainter *p, const QSize &size, GlyphCache *cache, const QRectF &visible) const {
+    renderClipped(p, size, cache, visible, nullptr);
+}
+
+void Layout::renderClipped(QPainter *p, const QSize &size, GlyphCache *cache, const QRectF &visible,
+                           const QRegion *region) const {
+    if (words.empty() || reference.isEmpty() || size.isEmpty()) return;
+    Profiler::Scope scope(Profiler::Stage::Draw);
+
+    GlyphCache local;
+    GlyphCache &glyphCache = cache != nullptr ? *cache : local;
+
+    const double scale = std::min(double(size.width()) / reference.width(), double(size.height()) / reference.height());
+    const double offsetX = (size.width() - reference.width() * scale) / 2;
+    const double offsetY = (size.height() - reference.height() * scale) / 2;
+
+    // слова раскладывались в пикселях reference, поэтому рисуем в них же и масштабируем painter
+    p->save();
+    p->translate(offsetX, offsetY);
+    p->scale(scale, scale);
+
+    for (const Word &word : words) {
+        const int fontSize = qRound(word.fontSize * reference.height());
+        const GlyphCache::Glyphs glyphs = glyphCache.lookup(fontFamily, fontSize, fontWeight, word.text);
+        // QStaticText рисуется от левого верхнего угла, а в раскладке - базовая линия
+        const QPointF topLeft(word.x * reference.width(), word.baseline * reference.height() - glyphs.ascent);
+
+        if (!visible.isNull()) {
+            // запас на тень, выносные элементы и сглаживание
+            const double margin = glyphs.height / 4.0 + 2;
+            const QRectF bounds(offsetX + (topLeft.x() - margin) * scale, offsetY + (topLeft.y() - margin) * scale,
+                                (glyphs.width + 1 + 2 * margin) * scale, (glyphs.height + 1 + 2 * margin) * scale);
+            if (!bounds.intersects(visible)) continue;
+            if (region != nullptr && !region->intersects(bounds.toAlignedRect())) continue;
+        }
+
+        p->setFont(*glyphs.font);
+        p->setPen(QColor(0, 0, 0, 80));
+        p->drawStaticText(topLeft + QPointF(1, 1), *glyphs.text);
+        p->setPen(word.color);
+        p->drawStaticText(topLeft, *glyphs.text);
+    }
+
+    p->restore();
+}
+
+void Layout::repaint(QImage &image, const std::vector<QRect> &dirty, GlyphCache *cache) const {
+    if (dirty.empty()) return;
+    Profiler::Scope scope(Profiler::Stage::Draw);
+
+    QRegion region;
+    for (const QRect &rect : dirty) region += rect;
+
+    QPainter painter(&image);
+    painter.setClipRegion(region);
+    for (const QRect &rect : dirty) painter.fillRect(rect, Qt::white);
+    // охватывающий прямоугольник отсекает быстро, а сам регион - слова между далёкими изменениями
+    renderClipped(&painter, image.size(), cache, QRectF(region.boundingRect()), &region);
+}
+
+QImage Layout::toImage(const QSize &size, GlyphCache *cache) const {
+    QImage image(size, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    render(&painter, size, cache);
+    painter.end();
+    return image;
+}
+
+QByteArray Layout::toSvg(const QSize &size) const {
+    QString svg = QString("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%1\" height=\"%2\" viewBox=\"0 0 %1 %2\">\n"
+                          "<rect width=\"100%\" height=\"100%\" fill=\"#ffffff\"/>\n")
+                      .arg(size.width())
+                      .arg(size.height());
+
+    if (!words.empty() && !reference.isEmpty() && !size.isEmpty()) {
+        const double scale = std::min(double(size.width()) / reference.width(), double(size.height()) / reference.height());
+        const double offsetX = (size.width() - reference.width() * scale) / 2;
+        const double offsetY = (size.height() - reference.height() * scale) / 2;
+
+        svg += QString("<g transform=\"translate(%1 %2) scale(%3)\" font-family=\"%4\" font-weight=\"%5\">\n")
+                   .arg(QString::number(offsetX), QString::number(offsetY), QString::number(scale),
+                        fontFamily.toHtmlEscaped(), QString::number(fontWeight));
+
+        for (const Word &word : words) {
+            // кегль в пунктах, а QImage рисует с 96 точками на дюйм - переводим в пиксели SVG
+            const QString fontSize = QString::number(qRound(word.fontSize * reference.height()) * 96.0 / 72.0);
+            const double x = word.x * reference.width();
+            const double y = word.baseline * reference.height();
+            const QString text = word.text.toHtmlEscaped();
+
+            svg += QString("<text x=\"%1\" y=\"%2\" font-size=\"%3\" fill=\"#000000\" fill-opacity=\"0.31\">%4</text>\n")
+                       .arg(QString::number(x + 1), QString::number(y + 1), fontSize, text);
+            svg += QString("<text x=\"%1\" y=\"%2\" font-size=\"%3\" fill=\"%4\">%5</text>\n")
+                       .arg(QString::number(x), QString::number(y), fontSize, word.color.name(), text);
+        }
+        svg += "</g>\n";
+    }
+
+    svg += "</svg>\n";
+    return svg.toUtf8();
+}
+
+bool Layout::writePdf(QIODevice *device, const QSize &size) const {
+    QPdfWriter writer(device);
+    // 96 точек на дюйм, как у QImage: кегль в пунктах занимает столько же пикселей, что и на картинке
+    writer.setResolution(96);
+    writer.setPageSize(QPageSize(QSizeF(size) * 72.0 / 96.0, QPageSize::Point, QString(), QPageSize::ExactMatch));
+    writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+    writer.setCreator("WordCloudGenerator");
+
+    QPainter painter;
+    if (!painter.begin(&writer)) return false;
+    render(&painter, size);
+    return painter.end();
+}
+
+QByteArray Layout::toJson() const {
+    QJsonArray items;
+    for (const Word &word : words) {
+        QJsonObject item;
+        item.insert("text", word.text);
+        item.insert("x", word.x);
+        item.insert("baseline", word.baseline);
+        item.insert("fontSize", word.fontSize);
+        item.insert("color", word.color.name());
+        items.append(item);
+    }
+
+    QJsonObject root;
+    root.insert("width", reference.width());
+    root.insert("height", reference.height());
+    root.insert("fontFamily", fontFamily);
+    root.insert("fontWeight", fontWeight);
+    root.insert("words", items);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool Layout::fromJson(const QByteArray &json, Layout &layout) {
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject()) return false;
+
+    const QJsonObject root = document.object();
+    Layout result;
+    result.reference = QSize(root.value("width").toInt(), root.value("height").toInt());
+    result.fontFamily = root.value("fontFamily").toString();
+    result.fontWeight = root.value("fontWeight").toInt(QFont::Bold);
+    if (result.reference.isEmpty() || result.fontFamily.isEmpty() || !root.value("words").isArray()) return false;
+
+    const QJsonArray items = root.value("words").toArray();
+    for (const QJsonValue &value : items) {
+        const QJsonObject item = value.toObject();
+        const QColor color = QColor::fromString(item.value("color").toString());
+        Word word{item.value("text").toString(), item.value("x").toDouble(), item.value("baseline").toDouble(),
+                  item.value("fontSize").toDouble(), color};
+        if (word.text.isEmpty() || word.fontSize <= 0 || !color.isValid()) return false;
+        result.words.push_back(word);
+    }
+
+    layout = std::move(result);
+    return true;
+}
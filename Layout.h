@@ -0,0 +1,58 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <QByteArray>
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <vector>
+
+class QIODevice;
+class QPainter;
+class QRegion;
+class GlyphCache;
+
+// Готовая раскладка облака, не привязанная к размеру картинки: координаты и кегль заданы
+// долями ширины и высоты холста, для которого раскладка считалась. Одну раскладку можно
+// нарисовать в любом размере (с сохранением пропорций) и сохранить в JSON.
+struct Layout {
+    struct Word {
+        QString text;
+        double x;         // левый край слова, доля ширины
+        double baseline;  // базовая линия, доля высоты
+        double fontSize;  // кегль в пунктах, доля высоты
+        QColor color;
+    };
+
+    QSize reference;  // холст, на котором считалась раскладка, задаёт пропорции
+    QString fontFamily = "Arial";
+    int fontWeight = QFont::Bold;
+    std::vector<Word> words;
+
+    // Рисует раскладку в прямоугольник size: масштаб по меньшей стороне, по центру.
+    // cache позволяет не разбирать заново текст при нескольких отрисовках.
+    // Если задан visible (в координатах size), слова вне него пропускаются - так рисуются плитки.
+    void render(QPainter *p, const QSize &size, GlyphCache *cache = nullptr, const QRectF &visible = QRectF()) const;
+    // Перерисовывает в image (холст reference) только прямоугольники dirty: фон и слова, которые их задевают.
+    // Так кадр анимации рисуется поверх предыдущего за время, пропорциональное изменениям.
+    void repaint(QImage &image, const std::vector<QRect> &dirty, GlyphCache *cache = nullptr) const;
+    // Белая картинка size с нарисованной раскладкой.
+    QImage toImage(const QSize &size, GlyphCache *cache = nullptr) const;
+    // Та же картинка векторами: SVG с текстом и одностраничный PDF размером size.
+    QByteArray toSvg(const QSize &size) const;
+    bool writePdf(QIODevice *device, const QSize &size) const;
+
+    QByteArray toJson() const;
+    static bool fromJson(const QByteArray &json, Layout &layout);
+
+private:
+    // render, который ещё пропускает слова, не задевающие region (в координатах size)
+    void renderClipped(QPainter *p, const QSize &size, GlyphCache *cache, const QRectF &visible,
+                       const QRegion *region) const;
+};
+
+#endif
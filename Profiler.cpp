@@ -0,0 +1,145 @@
+#include "Profiler.h"
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+constexpr int STAGES = static_cast<int>(Profiler::Stage::COUNT);
+constexpr int COUNTERS = static_cast<int>(Profiler::Counter::COUNT);
+
+const char *const STAGE_NAMES[STAGES] = {"read", "lower", "split", "tokenize", "count", "merge", "rank",
+                                         "layout", "shape", "draw", "encode", "cache"};
+const char *const COUNTER_NAMES[COUNTERS] = {"bytesRead", "files", "tokens", "filtered", "distinctWords",
+                                             "wordsPlaced", "wordsSkipped", "glyphMisses", "allocations"};
+
+// нулевая инициализация статическая, так что счётчики можно трогать даже из operator new до main
+std::atomic<bool> recording{false};
+std::atomic<bool> tracing{false};
+std::atomic<qint64> origin{0};
+std::atomic<qint64> stageNs[STAGES];
+std::atomic<qint64> stageCalls[STAGES];
+std::atomic<qint64> counters[COUNTERS];
+std::atomic<int> nextThreadId{0};
+
+struct TraceEvent {
+    int stage;
+    int thread;
+    qint64 start;
+    qint64 duration;
+};
+
+QMutex traceMutex;
+std::vector<TraceEvent> events;
+qint64 droppedEvents = 0;
+
+qint64 nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int threadId() {
+    thread_local const int id = nextThreadId++;
+    return id;
+}
+
+}
+
+Profiler::Scope::Scope(Stage stage) : stage(stage), start(recording.load(std::memory_order_relaxed) ? nowNs() : -1) {}
+
+Profiler::Scope::~Scope() {
+    if (start < 0) return;
+    const qint64 duration = nowNs() - start;
+    const int index = static_cast<int>(stage);
+    stageNs[index].fetch_add(duration, std::memory_order_relaxed);
+    stageCalls[index].fetch_add(1, std::memory_order_relaxed);
+
+    if (!tracing.load(std::memory_order_relaxed)) return;
+    QMutexLocker lock(&traceMutex);
+    if (events.size() < MAX_TRACE_EVENTS) {
+        events.push_back({index, threadId(), start, duration});
+    } else {
+        droppedEvents++;
+    }
+}
+
+void Profiler::setEnabled(bool enabled) {
+    if (enabled && !recording.load()) origin = nowNs();
+    recording = enabled;
+    if (!enabled) tracing = false;
+}
+
+bool Profiler::enabled() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+void Profiler::setTracing(bool enabled) {
+    if (enabled) setEnabled(true);
+    tracing = enabled;
+}
+
+void Profiler::add(Counter counter, qint64 n) {
+    if (!recording.load(std::memory_order_relaxed)) return;
+    counters[static_cast<int>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+void Profiler::set(Counter counter, qint64 value) {
+    if (!recording.load(std::memory_order_relaxed)) return;
+    counters[static_cast<int>(counter)].store(value, std::memory_order_relaxed);
+}
+
+void Profiler::reset() {
+    for (int i = 0; i < STAGES; i++) {
+        stageNs[i] = 0;
+        stageCalls[i] = 0;
+    }
+    for (int i = 0; i < COUNTERS; i++) {
+        counters[i] = 0;
+    }
+    origin = nowNs();
+
+    QMutexLocker lock(&traceMutex);
+    events.clear();
+    droppedEvents = 0;
+}
+
+QJsonObject Profiler::toJson() {
+    QJsonObject stages;
+    for (int i = 0; i < STAGES; i++) {
+        const qint64 calls = stageCalls[i].load();
+        if (calls == 0) continue;
+        stages.insert(STAGE_NAMES[i], QJsonObject{{"ms", stageNs[i].load() / 1e6}, {"calls", calls}});
+    }
+
+    QJsonObject values;
+    for (int i = 0; i < COUNTERS; i++) {
+        values.insert(COUNTER_NAMES[i], counters[i].load());
+    }
+
+    return QJsonObject{{"elapsedMs", (nowNs() - origin.load()) / 1e6}, {"stages", stages}, {"counters", values}};
+}
+
+QByteArray Profiler::traceJson() {
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray items;
+    qint64 dropped;
+    {
+        QMutexLocker lock(&traceMutex);
+        for (const TraceEvent &event : events) {
+            // ph "X" - законченное событие с длительностью, время в микросекундах
+            items.append(QJsonObject{{"name", STAGE_NAMES[event.stage]}, {"ph", "X"}, {"pid", pid},
+                                     {"tid", event.thread}, {"ts", (event.start - origin.load()) / 1e3},
+                                     {"dur", event.duration / 1e3}});
+        }
+        dropped = droppedEvents;
+    }
+
+    QJsonObject root{{"traceEvents", items}, {"displayTimeUnit", "ms"}};
+    if (dropped > 0) root.insert("droppedEvents", dropped);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
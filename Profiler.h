@@ -0,0 +1,47 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QtGlobal>
+
+// Встроенные таймеры стадий и счётчики. Пока запись выключена, Scope и add стоят одной проверки
+// атомарного флага, поэтому они стоят прямо в рабочем коде и остаются в релизной сборке.
+// Время стадии суммируется по всем потокам и включает вложенные стадии (например, shape внутри layout).
+class Profiler {
+public:
+    enum class Stage { Read, Lower, Split, Tokenize, Count, Merge, Rank, Layout, Shape, Draw, Encode, Cache, COUNT };
+    enum class Counter { BytesRead, Files, Tokens, Filtered, DistinctWords, WordsPlaced, WordsSkipped, GlyphMisses,
+                         Allocations, COUNT };
+
+    class Scope {
+    public:
+        explicit Scope(Stage stage);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Stage stage;
+        qint64 start;  // -1, если запись выключена
+    };
+
+    static void setEnabled(bool enabled);
+    static bool enabled();
+    // Дополнительно копить события для chrome://tracing (включает и запись).
+    static void setTracing(bool tracing);
+
+    static void add(Counter counter, qint64 n = 1);
+    static void set(Counter counter, qint64 value);
+    // Обнуляет таймеры, счётчики и события; elapsedMs отсчитывается заново.
+    static void reset();
+
+    // {"elapsedMs", "stages": {имя: {"ms", "calls"}}, "counters": {имя: значение}}
+    static QJsonObject toJson();
+    // Формат Trace Event (массив traceEvents) для chrome://tracing и Perfetto.
+    static QByteArray traceJson();
+
+    static constexpr size_t MAX_TRACE_EVENTS = 1 << 20;
+};
+
+#endif
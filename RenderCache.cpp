@@ -0,0 +1,112 @@
+#include "RenderCache.h"
+#include "WordCloudGenerator.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <algorithm>
+
+namespace {
+
+// BLAKE2b заметно быстрее SHA-2 на больших входах; ключ обрезается до 128 бит, совпадений этого не бояться
+constexpr QCryptographicHash::Algorithm HASH = QCryptographicHash::Blake2b_256;
+
+}
+
+RenderCache::RenderCache(const QString &directory, qint64 maxBytes)
+    : directory(directory), maxBytes(std::max<qint64>(maxBytes, 0)) {
+    valid = QDir().mkpath(directory);
+}
+
+QByteArray RenderCache::hashData(const QByteArray &data) {
+    return QCryptographicHash::hash(data, HASH);
+}
+
+QByteArray RenderCache::hashFile(const QString &path) {
+    QFile file(path);
+    QCryptographicHash hash(HASH);
+    if (!file.open(QIODevice::ReadOnly) || !hash.addData(&file)) return QByteArray();
+    return hash.result();
+}
+
+QByteArray RenderCache::key(const QByteArray &inputHash, const QStringList &parameters) {
+    QCryptographicHash hash(HASH);
+    hash.addData(inputHash);
+    // разделитель не встречается в параметрах, так что разные наборы не склеиваются в одну строку
+    hash.addData(parameters.join(QChar(0)).toUtf8());
+    return hash.result().left(16).toHex();
+}
+
+QString RenderCache::entryPath(const QByteArray &key) const {
+    return directory + "/" + QString::fromLatin1(key);
+}
+
+bool RenderCache::lookup(const QByteArray &key, QByteArray &image) {
+    QFile file(entryPath(key));
+    if (!valid || !file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly)) {
+        missCount++;
+        return false;
+    }
+
+    image = file.readAll();
+    file.close();
+    if (image.isEmpty()) {
+        missCount++;
+        return false;
+    }
+
+    // отметка использования для LRU; для setFileTime на Windows нужен доступ на запись.
+    // Если не вышло (каталог только для чтения, запись только что вытеснили), не страшно
+    QFile touch(entryPath(key));
+    if (touch.open(QIODevice::ReadWrite | QIODevice::ExistingOnly)) {
+        touch.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    }
+    hitCount++;
+    return true;
+}
+
+bool RenderCache::store(const QByteArray &key, const QByteArray &image) {
+    if (!valid || image.isEmpty() || image.size() > maxBytes) return false;
+
+    QSaveFile file(entryPath(key));
+    if (!file.open(QIODevice::WriteOnly) || file.write(image) != image.size() || !file.commit()) return false;
+
+    evict();
+    return true;
+}
+
+void RenderCache::evict() {
+    QLockFile lock(directory + "/.lock");
+    // каталог уже чистит другой процесс (или поток) - он справится и за нас
+    if (!lock.tryLock(0)) return;
+
+    // имена записей - hex без точек; файлы с точкой - блокировка и недописанные файлы QSaveFile
+    QFileInfoList entries;
+    qint64 total = 0;
+    for (const QFileInfo &entry : QDir(directory).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed)) {
+        if (entry.fileName().contains('.')) continue;
+        entries.append(entry);
+        total += entry.size();
+    }
+
+    // от давно не использованных к свежим
+    for (const QFileInfo &entry : entries) {
+        if (total <= maxBytes) break;
+        if (QFile::remove(entry.filePath())) total -= entry.size();
+    }
+}
+
+QStringList cloudCacheParameters(const QString &source, const QString &shape, const QSize &size,
+                                 const ImageOptions &image, quint32 seed, int words,
+                                 qint64 approxCounters, qint64 approxSketch, const QString &normalizer) {
+    QStringList parameters = {QString::number(WordCloudGenerator::VERSION), source, shape.toLower(),
+            QString::number(size.width()), QString::number(size.height()), outputFormatExtension(image.format),
+            QString::number(image.pngLevel), QString::number(seed), QString::number(words),
+            QString::number(approxCounters), QString::number(approxSketch)};
+    // без нормализации ключи остаются прежними, и старые записи кэша не пропадают
+    if (!normalizer.isEmpty()) parameters.append(normalizer);
+    return parameters;
+}
@@ -0,0 +1,55 @@
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QByteArray>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include "ImageOutput.h"
+
+// Кэш готовых картинок на диске, адресуемый содержимым: имя файла - хэш входного текста
+// и всех параметров, от которых зависит картинка. Запись атомарна (QSaveFile пишет во временный
+// файл и переименовывает), так что несколько процессов могут работать с одним каталогом.
+// Время изменения файла служит отметкой последнего использования; когда каталог больше maxBytes,
+// удаляются давно не использованные записи (LRU). Удаление под QLockFile, чтобы процессы не чистили
+// каталог одновременно.
+class RenderCache {
+public:
+    explicit RenderCache(const QString &directory, qint64 maxBytes = DEFAULT_MAX_BYTES);
+
+    bool isValid() const { return valid; }
+
+    // Хэш входного текста: целиком из памяти или потоково из файла (пустой, если файл не читается).
+    static QByteArray hashData(const QByteArray &data);
+    static QByteArray hashFile(const QString &path);
+    // Ключ записи; parameters - всё, что влияет на картинку, кроме текста (форма, размер, формат, seed...).
+    static QByteArray key(const QByteArray &inputHash, const QStringList &parameters);
+
+    bool lookup(const QByteArray &key, QByteArray &image);
+    bool store(const QByteArray &key, const QByteArray &image);
+
+    quint64 hits() const { return hitCount.load(); }
+    quint64 misses() const { return missCount.load(); }
+
+    static constexpr qint64 DEFAULT_MAX_BYTES = qint64(256) << 20;
+
+private:
+    QString directory;
+    qint64 maxBytes;
+    bool valid = false;
+    std::atomic<quint64> hitCount{0};
+    std::atomic<quint64> missCount{0};
+
+    QString entryPath(const QByteArray &key) const;
+    void evict();
+};
+
+// Параметры ключа для картинки облака. CLI и сервер собирают их одинаково, поэтому делят записи;
+// source различает текст и снимок частот, normalizer описывает стоп-слова и стемминг (пусто - без них).
+QStringList cloudCacheParameters(const QString &source, const QString &shape, const QSize &size,
+                                 const ImageOptions &image, quint32 seed, int words,
+                                 qint64 approxCounters = 0, qint64 approxSketch = 0,
+                                 const QString &normalizer = QString());
+
+#endif
@@ -0,0 +1,60 @@
+#include "RenderProtocol.h"
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QLocalSocket>
+#include <QtEndian>
+
+QByteArray encodeFrame(const QJsonObject &header, const QByteArray &body) {
+    const QByteArray json = QJsonDocument(header).toJson(QJsonDocument::Compact);
+    const quint32 frameSize = static_cast<quint32>(4 + json.size() + body.size());
+
+    QByteArray frame;
+    frame.reserve(4 + frameSize);
+    char size[4];
+    qToBigEndian(frameSize, size);
+    frame.append(size, 4);
+    qToBigEndian(static_cast<quint32>(json.size()), size);
+    frame.append(size, 4);
+    frame.append(json);
+    frame.append(body);
+    return frame;
+}
+
+bool decodeFrame(QByteArray &buffer, RenderMessage &message, bool &error) {
+    error = false;
+    if (buffer.size() < 4) return false;
+
+    const quint32 frameSize = qFromBigEndian<quint32>(buffer.constData());
+    if (frameSize < 4 || frameSize > MAX_FRAME_SIZE) {
+        error = true;
+        return false;
+    }
+    if (static_cast<quint64>(buffer.size()) < 4ull + frameSize) return false;
+
+    const quint32 headerSize = qFromBigEndian<quint32>(buffer.constData() + 4);
+    if (headerSize > frameSize - 4) {
+        error = true;
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(buffer.mid(8, headerSize), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        error = true;
+        return false;
+    }
+
+    message.header = document.object();
+    message.body = buffer.mid(8 + headerSize, frameSize - 4 - headerSize);
+    buffer.remove(0, 4 + frameSize);
+    return true;
+}
+
+bool readFrame(QLocalSocket &socket, QByteArray &buffer, RenderMessage &message, int timeoutMs) {
+    bool error = false;
+    while (!decodeFrame(buffer, message, error)) {
+        if (error || !socket.waitForReadyRead(timeoutMs)) return false;
+        buffer += socket.readAll();
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef RENDERPROTOCOL_H
+#define RENDERPROTOCOL_H
+
+#include <QByteArray>
+#include <QJsonObject>
+
+class QLocalSocket;
+
+// Протокол сервера отрисовки (WordCloud --serve). Поток состоит из кадров:
+//   quint32 длина кадра, quint32 длина заголовка, JSON-заголовок, тело.
+// Числа big-endian. В запросе тело - текст (UTF-8), в ответе - байты картинки.
+// Запрос:  {"id": 1, "type": "render", "shape": "spiral", "width": 800, "height": 600,
+//           "format": "jpg"|"png", "file": "путь" (вместо текста в теле, внутри --serve-root), "seed": 1, "words": 0}
+//          {"id": 2, "type": "stats"}
+// Ответ:   {"id": 1, "ok": true, "format": "jpg"} + картинка или {"id": 1, "ok": false, "error": "..."}.
+// Запросы можно слать не дожидаясь ответов, ответы приходят в порядке запросов.
+// Кадры больше MAX_FRAME_SIZE не принимаются; картинку больше него сервер заменяет ошибкой.
+struct RenderMessage {
+    QJsonObject header;
+    QByteArray body;
+};
+
+QByteArray encodeFrame(const QJsonObject &header, const QByteArray &body = QByteArray());
+
+// Снимает с начала buffer один целый кадр. false - кадр ещё не дочитан или поток испорчен (error).
+bool decodeFrame(QByteArray &buffer, RenderMessage &message, bool &error);
+
+// Блокирующее чтение одного кадра для клиентов без цикла событий.
+bool readFrame(QLocalSocket &socket, QByteArray &buffer, RenderMessage &message, int timeoutMs = 30000);
+
+constexpr quint32 MAX_FRAME_SIZE = 256u << 20;
+
+#endif
@@ -0,0 +1,257 @@
+#include "RenderServer.h"
+#include "WordCloudGenerator.h"
+#include "ImageOutput.h"
+#include "RenderCache.h"
+#include "Profiler.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <algorithm>
+
+RenderServer::RenderServer(int workers, int maxQueue)
+    : maxQueue(std::max(1, maxQueue)) {
+    pool.setMaxThreadCount(std::max(1, workers));
+    // потоки не завершаются, чтобы генераторы в них оставались прогретыми
+    pool.setExpiryTimeout(-1);
+    latencies.reserve(LATENCY_WINDOW);
+    QObject::connect(&server, &QLocalServer::newConnection, [this]() { accept(); });
+}
+
+RenderServer::~RenderServer() {
+    server.close();
+    pool.waitForDone();
+}
+
+bool RenderServer::listen(const QString &name) {
+    // живой сервер принимает подключение - его сокет не трогаем
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(1000)) {
+        qCritical() << "Error: server is already running on" << name;
+        return false;
+    }
+
+    // никто не ответил: сокет мог остаться от упавшего процесса
+    QLocalServer::removeServer(name);
+    if (!server.listen(name)) {
+        qCritical() << "Error: Can`t listen on" << name << server.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool RenderServer::setFileRoot(const QString &directory) {
+    const QString root = QDir(directory).canonicalPath();
+    if (root.isEmpty() || !QFileInfo(root).isDir()) return false;
+    fileRoot = root.endsWith('/') ? root : root + '/';
+    return true;
+}
+
+// Файл из запроса внутри fileRoot: относительный путь отсчитывается от неё, .. и ссылки раскрываются
+// до проверки, так что выйти за папку нельзя. Пусто - файла нет или он снаружи.
+QString RenderServer::resolveFile(const QString &file) const {
+    const QString path = QFileInfo(QDir(fileRoot).filePath(file)).canonicalFilePath();
+    if (path.isEmpty() || !path.startsWith(fileRoot)) return QString();
+    return path;
+}
+
+void RenderServer::accept() {
+    while (server.hasPendingConnections()) {
+        QLocalSocket *socket = server.nextPendingConnection();
+        auto connection = std::make_shared<Connection>();
+        connection->socket = socket;
+
+        QObject::connect(socket, &QLocalSocket::readyRead, [this, connection]() { readRequests(connection); });
+        QObject::connect(socket, &QLocalSocket::disconnected, [connection]() {
+            connection->closed = true;
+            connection->socket->deleteLater();
+        });
+    }
+}
+
+void RenderServer::readRequests(const std::shared_ptr<Connection> &connection) {
+    connection->buffer += connection->socket->readAll();
+
+    RenderMessage request;
+    bool error = false;
+    while (decodeFrame(connection->buffer, request, error)) {
+        const quint64 seq = connection->nextSeq++;
+        const QJsonValue id = request.header.value("id");
+        const QString type = request.header.value("type").toString("render");
+
+        if (type == "stats") {
+            QJsonObject header = stats();
+            header.insert("id", id);
+            header.insert("ok", true);
+            finish(connection, seq, encodeFrame(header));
+            continue;
+        }
+
+        if (inFlight.load() >= maxQueue) {
+            {
+                QMutexLocker lock(&statsMutex);
+                rejected++;
+            }
+            QJsonObject header{{"id", id}, {"ok", false}, {"error", "busy"}};
+            finish(connection, seq, encodeFrame(header));
+            continue;
+        }
+
+        inFlight++;
+        QElapsedTimer timer;
+        timer.start();
+        pool.start([this, connection, seq, request, id, timer]() {
+            QJsonObject header;
+            const QByteArray body = render(request, header);
+            header.insert("id", id);
+            QByteArray response = encodeFrame(header, body);
+            if (static_cast<quint64>(response.size()) > 4ull + MAX_FRAME_SIZE) {
+                // клиент отбросит такой кадр как испорченный, поэтому вместо картинки - ошибка
+                header = QJsonObject{{"id", id}, {"ok", false}, {"error", "image is larger than the frame limit"}};
+                response = encodeFrame(header);
+            }
+            const bool ok = header.value("ok").toBool();
+            record(timer.nsecsElapsed() / 1000, ok);
+            inFlight--;
+
+            // сокетом владеет главный поток, туда и отдаём ответ
+            QMetaObject::invokeMethod(&server, [this, connection, seq, response]() {
+                finish(connection, seq, response);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    if (error) {
+        qWarning() << "Warning: malformed request frame, closing the connection";
+        connection->closed = true;
+        connection->socket->disconnectFromServer();
+    }
+}
+
+void RenderServer::finish(const std::shared_ptr<Connection> &connection, quint64 seq, const QByteArray &response) {
+    if (connection->closed) return;
+
+    // ответы уходят строго в порядке запросов, даже если рисовались не по порядку
+    connection->ready.emplace(seq, response);
+    for (auto it = connection->ready.begin(); it != connection->ready.end() && it->first == connection->nextToWrite;) {
+        connection->socket->write(it->second);
+        it = connection->ready.erase(it);
+        connection->nextToWrite++;
+    }
+}
+
+void RenderServer::record(qint64 latencyUs, bool ok) {
+    QMutexLocker lock(&statsMutex);
+    if (latencies.size() < LATENCY_WINDOW) {
+        latencies.push_back(latencyUs);
+    } else {
+        latencies[latencyNext] = latencyUs;
+    }
+    latencyNext = (latencyNext + 1) % LATENCY_WINDOW;
+    served++;
+    if (!ok) failed++;
+}
+
+QJsonObject RenderServer::stats() const {
+    std::vector<qint64> sorted;
+    QJsonObject result;
+    {
+        QMutexLocker lock(&statsMutex);
+        sorted = latencies;
+        result.insert("served", static_cast<qint64>(served));
+        result.insert("failed", static_cast<qint64>(failed));
+        result.insert("rejected", static_cast<qint64>(rejected));
+    }
+    result.insert("inFlight", inFlight.load());
+    result.insert("workers", pool.maxThreadCount());
+    result.insert("cacheHits", cache != nullptr ? static_cast<qint64>(cache->hits()) : 0);
+    result.insert("cacheMisses", cache != nullptr ? static_cast<qint64>(cache->misses()) : 0);
+    // таймеры стадий накапливаются с запуска сервера (--stats)
+    if (Profiler::enabled()) result.insert("profile", Profiler::toJson());
+
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) -> qint64 {
+        if (sorted.empty()) return 0;
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+    };
+    result.insert("p50Us", percentile(0.50));
+    result.insert("p90Us", percentile(0.90));
+    result.insert("p99Us", percentile(0.99));
+    result.insert("maxUs", sorted.empty() ? 0 : sorted.back());
+    return result;
+}
+
+QByteArray RenderServer::render(const RenderMessage &request, QJsonObject &header) {
+    const QString shape = request.header.value("shape").toString("spiral").toLower();
+    const QSize size(request.header.value("width").toInt(800), request.header.value("height").toInt(600));
+    const QString format = request.header.value("format").toString("jpg").toLower();
+    const QString requestedFile = request.header.value("file").toString();
+    const quint32 seed = static_cast<quint32>(request.header.value("seed").toInteger(WordCloudGenerator::DEFAULT_SEED));
+    const int words = request.header.value("words").toInt(0);
+
+    auto fail = [&header](const QString &message) {
+        header.insert("ok", false);
+        header.insert("error", message);
+        return QByteArray();
+    };
+
+    if (!WordCloudGenerator::shapes().contains(shape)) return fail("unknown shape");
+    if (size.width() < 100 || size.height() < 100) return fail("minimum image size is 100 by 100 pixels");
+    ImageOptions options;
+    if (!outputFormatFromName(format, options.format)) return fail("format must be jpg, png, bmp, raw, svg or pdf");
+
+    QString file;
+    if (!requestedFile.isEmpty()) {
+        if (fileRoot.isEmpty()) return fail("file requests are disabled, send the text instead");
+        file = resolveFile(requestedFile);
+        if (file.isEmpty()) return fail("file not found inside the server root");
+    }
+
+    QByteArray cacheKey;
+    if (cache != nullptr) {
+        const QByteArray inputHash = file.isEmpty() ? RenderCache::hashData(request.body) : RenderCache::hashFile(file);
+        if (inputHash.isEmpty()) return fail("can`t read file");
+        cacheKey = RenderCache::key(inputHash, cloudCacheParameters("text", shape, size, options, seed, words));
+
+        QByteArray bytes;
+        if (cache->lookup(cacheKey, bytes)) {
+            header.insert("ok", true);
+            header.insert("format", format);
+            header.insert("cached", true);
+            return bytes;
+        }
+    }
+
+    // генератор на поток пула: шрифты, кэш глифов и кодеки картинок прогреваются один раз;
+    // создаётся при первом промахе, попадания в кэш обходятся без него
+    static thread_local WordCloudGenerator generator;
+
+    generator.setShape(shape);
+    generator.setSeed(seed);
+    generator.setMaxWords(words);
+
+    if (!file.isEmpty()) {
+        if (!generator.processFile(file)) return fail("can`t read file");
+    } else {
+        generator.processText(QString::fromUtf8(request.body));
+    }
+
+    const Layout layout = generator.computeLayout(size);
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    if (!writeImage(layout, size, options, buffer, &generator.glyphs())) {
+        return fail("can`t encode the image");
+    }
+    if (cache != nullptr) cache->store(cacheKey, bytes);
+
+    header.insert("ok", true);
+    header.insert("format", format);
+    return bytes;
+}
@@ -0,0 +1,77 @@
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+#include "RenderProtocol.h"
+
+class QLocalSocket;
+class RenderCache;
+
+// Долгоживущий сервер отрисовки на локальном сокете (Unix socket / named pipe).
+// Запросы разбираются в главном потоке и рисуются на пуле из workers потоков,
+// у каждого потока свой прогретый WordCloudGenerator. Одновременно в работе не больше
+// maxQueue запросов, лишние сразу получают ответ "busy".
+class RenderServer {
+public:
+    RenderServer(int workers, int maxQueue);
+    ~RenderServer();
+
+    // false (с сообщением об ошибке), если на этом имени уже работает другой сервер
+    bool listen(const QString &name);
+    QString errorString() const { return server.errorString(); }
+    QString fullServerName() const { return server.fullServerName(); }
+
+    // Папка, из которой запросы могут брать файлы по полю "file"; без неё такие запросы отклоняются.
+    // false, если папки нет.
+    bool setFileRoot(const QString &directory);
+
+    // Кэш готовых картинок (не принадлежит серверу); попадание отдаёт картинку без генератора.
+    void setCache(RenderCache *renderCache) { cache = renderCache; }
+
+    // счётчики, попадания в кэш и перцентили задержки (мкс) по последним LATENCY_WINDOW запросам
+    QJsonObject stats() const;
+
+private:
+    struct Connection {
+        QLocalSocket *socket;
+        QByteArray buffer;
+        quint64 nextSeq = 0;      // номер следующего запроса
+        quint64 nextToWrite = 0;  // номер запроса, чей ответ уходит следующим
+        std::map<quint64, QByteArray> ready;
+        bool closed = false;
+    };
+
+    QLocalServer server;
+    QThreadPool pool;
+    int maxQueue;
+    std::atomic<int> inFlight{0};
+    RenderCache *cache = nullptr;
+    QString fileRoot;  // канонический путь с / на конце, пусто - файлы запрещены
+
+    mutable QMutex statsMutex;
+    std::vector<qint64> latencies;
+    size_t latencyNext = 0;
+    quint64 served = 0;
+    quint64 failed = 0;
+    quint64 rejected = 0;
+
+    static constexpr size_t LATENCY_WINDOW = 4096;
+
+    void accept();
+    void readRequests(const std::shared_ptr<Connection> &connection);
+    void finish(const std::shared_ptr<Connection> &connection, quint64 seq, const QByteArray &response);
+    void record(qint64 latencyUs, bool ok);
+
+    QByteArray render(const RenderMessage &request, QJsonObject &header);
+    QString resolveFile(const QString &file) const;
+};
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef RESOURCEUSAGE_H
+#define RESOURCEUSAGE_H
+
+#include <QtGlobal>
+
+// Пиковый размер резидентной памяти процесса в байтах, 0 если неизвестен.
+qint64 peakRssBytes();
+
+#endif
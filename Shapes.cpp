@@ -0,0 +1,24 @@
+#include "Shapes.h"
+
+// таблицы строятся при компиляции: ошибка в контуре формы - ошибка сборки, а не пустая картинка
+static_assert(ShapeTable<SquareShape>::data.anchors[SquareShape::MAX_WORDS / 4].x == 1.0 / 3,
+              "a quarter of the square path must end at the top right corner");
+static_assert(ShapeTable<HeartShape>::data.position[HeartShape::VERTICES / 2] > 0.4
+              && ShapeTable<HeartShape>::data.position[HeartShape::VERTICES / 2] < 0.6,
+              "the heart must be symmetric");
+
+const ShapeInfo &findShape(const QString &name) {
+    for (const ShapeInfo &shape : SHAPES) {
+        if (name.compare(QLatin1String(shape.name), Qt::CaseInsensitive) == 0) return shape;
+    }
+    return SHAPES[0];
+}
+
+const QStringList &shapeNames() {
+    static const QStringList names = [] {
+        QStringList list;
+        for (const ShapeInfo &shape : SHAPES) list.append(QString::fromLatin1(shape.name));
+        return list;
+    }();
+    return names;
+}
@@ -0,0 +1,247 @@
+#ifndef SHAPES_H
+#define SHAPES_H
+
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Формы облака. Форма - класс с ломаной в единичных координатах: начало в центре холста,
+// единица - меньшая сторона холста, ось y вниз. vertex(k) для k = 0..VERTICES задаёт вершины,
+// EVEN_ARCS выбирает, как делится путь между словами: поровну по длине или по номеру вершины.
+// ShapeTable строит из неё таблицы во время компиляции, при раскладке точки только масштабируются.
+// Новая форма - такой класс и строчка в SHAPES.
+
+// constexpr-замены sin и sqrt из <cmath>, которые в C++17 не вычисляются при компиляции
+constexpr double SHAPE_PI = 3.14159265358979323846;
+
+constexpr double constexprSin(double x) {
+    // приведение к [-pi, pi], дальше ряд Тейлора
+    const double turns = (x + SHAPE_PI) / (2 * SHAPE_PI);
+    long long whole = static_cast<long long>(turns);
+    if (turns < whole) whole--;
+    x -= 2 * SHAPE_PI * whole;
+    double term = x;
+    double sum = x;
+    for (int k = 1; k < 20; k++) {
+        term *= -x * x / ((2.0 * k) * (2.0 * k + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constexprCos(double x) {
+    return constexprSin(x + SHAPE_PI / 2);
+}
+
+constexpr double constexprSqrt(double x) {
+    if (x <= 0) return 0;
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 200; i++) {
+        const double next = (r + x / r) / 2;
+        if (next >= r) break;
+        r = next;
+    }
+    return r;
+}
+
+struct UnitPoint {
+    double x = 0;
+    double y = 0;
+};
+
+template <typename Shape>
+struct ShapeTableData {
+    std::array<UnitPoint, Shape::VERTICES + 1> points{};
+    // доля пути до вершины: от 0 у первой до 1 у последней, строго возрастает
+    std::array<double, Shape::VERTICES + 1> position{};
+    // точки для MAX_WORDS слов - числа слов по умолчанию
+    std::array<UnitPoint, Shape::MAX_WORDS> anchors{};
+};
+
+// Точка на доле пути f из [0, 1): двоичный поиск отрезка и линейная интерполяция.
+template <typename Shape>
+constexpr UnitPoint locateOnShape(const ShapeTableData<Shape> &table, double f) {
+    std::size_t low = 0;
+    std::size_t high = Shape::VERTICES;
+    while (high - low > 1) {
+        const std::size_t middle = (low + high) / 2;
+        if (table.position[middle] <= f) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    const UnitPoint &a = table.points[low];
+    const UnitPoint &b = table.points[high];
+    const double ratio = (f - table.position[low]) / (table.position[high] - table.position[low]);
+    return {a.x + (b.x - a.x) * ratio, a.y + (b.y - a.y) * ratio};
+}
+
+template <typename Shape>
+constexpr ShapeTableData<Shape> buildShapeTable() {
+    constexpr std::size_t n = Shape::VERTICES;
+    ShapeTableData<Shape> table;
+    for (std::size_t k = 0; k <= n; k++) table.points[k] = Shape::vertex(k);
+
+    for (std::size_t k = 1; k <= n; k++) {
+        const double dx = table.points[k].x - table.points[k - 1].x;
+        const double dy = table.points[k].y - table.points[k - 1].y;
+        table.position[k] = table.position[k - 1] + (Shape::EVEN_ARCS ? constexprSqrt(dx * dx + dy * dy) : 1.0);
+    }
+    const double total = table.position[n];
+    for (std::size_t k = 1; k < n; k++) table.position[k] /= total;
+    table.position[n] = 1.0;
+
+    for (int i = 0; i < Shape::MAX_WORDS; i++) {
+        table.anchors[i] = locateOnShape<Shape>(table, double(i) / Shape::MAX_WORDS);
+    }
+    return table;
+}
+
+template <typename Shape>
+struct ShapeTable {
+    static constexpr ShapeTableData<Shape> data = buildShapeTable<Shape>();
+
+    // для числа слов по умолчанию - готовая точка, для другого - поиск по таблице длин
+    static constexpr UnitPoint anchor(int i, int count) {
+        return count == Shape::MAX_WORDS ? data.anchors[i] : locateOnShape<Shape>(data, double(i) / count);
+    }
+};
+
+// Точки первых count слов на холсте size: единичные координаты масштабируются меньшей стороной.
+template <typename Shape>
+void placeShapeAnchors(int count, const QSize &size, std::vector<QPoint> &positions) {
+    const double side = std::min(size.width(), size.height());
+    const int centerX = size.width() / 2;
+    const int centerY = size.height() / 2;
+    positions.reserve(positions.size() + count);
+    for (int i = 0; i < count; i++) {
+        const UnitPoint point = ShapeTable<Shape>::anchor(i, count);
+        positions.push_back(QPoint(centerX + static_cast<int>(point.x * side),
+                                   centerY + static_cast<int>(point.y * side)));
+    }
+}
+
+// Спираль в два оборота от 0.4 до 1.1 радиуса круга; слова идут через равные углы.
+struct SpiralShape {
+    static constexpr const char *NAME = "spiral";
+    static constexpr int MAX_WORDS = 50;
+    static constexpr int BASE_FONT_SIZE = 14;
+    static constexpr int FONT_MULTIPLIER = 16;
+    static constexpr std::size_t VERTICES = 256;
+    static constexpr bool EVEN_ARCS = false;
+
+    static constexpr UnitPoint vertex(std::size_t k) {
+        const double f = double(k) / VERTICES;
+        const double r = 0.33 * (0.4 + 0.7 * f);
+        return {r * constexprCos(4 * SHAPE_PI * f), r * constexprSin(4 * SHAPE_PI * f)};
+    }
+};
+
+struct CircleShape {
+    static constexpr const char *NAME = "circle";
+    static constexpr int MAX_WORDS = 40;
+    static constexpr int BASE_FONT_SIZE = 14;
+    static constexpr int FONT_MULTIPLIER = 18;
+    static constexpr std::size_t VERTICES = 256;
+    static constexpr bool EVEN_ARCS = true;
+
+    static constexpr UnitPoint vertex(std::size_t k) {
+        const double angle = 2 * SHAPE_PI * k / VERTICES;
+        return {0.33 * constexprCos(angle), 0.33 * constexprSin(angle)};
+    }
+};
+
+// квадрат со стороной 2/3 по часовой стрелке от левого верхнего угла
+struct SquareShape {
+    static constexpr const char *NAME = "square";
+    static constexpr int MAX_WORDS = 40;
+    static constexpr int BASE_FONT_SIZE = 12;
+    static constexpr int FONT_MULTIPLIER = 20;
+    static constexpr std::size_t VERTICES = 4;
+    static constexpr bool EVEN_ARCS = true;
+
+    static constexpr UnitPoint vertex(std::size_t k) {
+        constexpr UnitPoint corners[] = {{-1.0 / 3, -1.0 / 3}, {1.0 / 3, -1.0 / 3}, {1.0 / 3, 1.0 / 3}, {-1.0 / 3, 1.0 / 3}};
+        return corners[k % 4];
+    }
+};
+
+// высота 1/2, основание 3/4: вершина, правый и левый углы
+struct TriangleShape {
+    static constexpr const char *NAME = "triangle";
+    static constexpr int MAX_WORDS = 36;
+    static constexpr int BASE_FONT_SIZE = 12;
+    static constexpr int FONT_MULTIPLIER = 20;
+    static constexpr std::size_t VERTICES = 3;
+    static constexpr bool EVEN_ARCS = true;
+
+    static constexpr UnitPoint vertex(std::size_t k) {
+        constexpr UnitPoint corners[] = {{0, -0.25}, {0.375, 0.25}, {-0.375, 0.25}};
+        return corners[k % 3];
+    }
+};
+
+// классическая кривая сердца x = 16 sin^3 t, y = 13 cos t - 5 cos 2t - 2 cos 3t - cos 4t
+// с обходом от правой доли
+struct HeartShape {
+    static constexpr const char *NAME = "heart";
+    static constexpr int MAX_WORDS = 48;
+    static constexpr int BASE_FONT_SIZE = 12;
+    static constexpr int FONT_MULTIPLIER = 18;
+    static constexpr std::size_t VERTICES = 200;
+    static constexpr bool EVEN_ARCS = true;
+
+    static constexpr UnitPoint vertex(std::size_t k) {
+        const double t = 2 * SHAPE_PI * ((k + VERTICES / 4) % VERTICES) / VERTICES;
+        const double s = constexprSin(t);
+        const double x = 16 * s * s * s;
+        const double y = 13 * constexprCos(t) - 5 * constexprCos(2 * t) - 2 * constexprCos(3 * t) - constexprCos(4 * t);
+        return {x / 51, -y / 51};
+    }
+};
+
+// пятиконечная звезда: внешний радиус 1/3, внутренний 1/6, первый луч вверх
+struct StarShape {
+    static constexpr const char *NAME = "star";
+    static constexpr int MAX_WORDS = 50;
+    static constexpr int BASE_FONT_SIZE = 12;
+    static constexpr int FONT_MULTIPLIER = 18;
+    static constexpr std::size_t VERTICES = 10;
+    static constexpr bool EVEN_ARCS = true;
+
+    static constexpr UnitPoint vertex(std::size_t k) {
+        const double angle = 2 * SHAPE_PI * k / VERTICES - SHAPE_PI / 2;
+        const double r = k % 2 == 0 ? 1.0 / 3 : 1.0 / 6;
+        return {r * constexprCos(angle), r * constexprSin(angle)};
+    }
+};
+
+struct ShapeInfo {
+    const char *name;
+    int maxWords;
+    int baseFontSize;
+    int fontMultiplier;
+    void (*anchors)(int count, const QSize &size, std::vector<QPoint> &positions);
+};
+
+template <typename... Shapes>
+constexpr std::array<ShapeInfo, sizeof...(Shapes)> makeShapeRegistry() {
+    return {{ShapeInfo{Shapes::NAME, Shapes::MAX_WORDS, Shapes::BASE_FONT_SIZE, Shapes::FONT_MULTIPLIER,
+                       &placeShapeAnchors<Shapes>}...}};
+}
+
+// порядок - порядок списка форм; первая форма - форма по умолчанию
+inline constexpr auto SHAPES = makeShapeRegistry<SpiralShape, CircleShape, SquareShape, TriangleShape, HeartShape,
+                                                 StarShape>();
+
+// Форма по имени без учёта регистра; незнакомое имя - форма по умолчанию.
+const ShapeInfo &findShape(const QString &name);
+const QStringList &shapeNames();
+
+#endif
@@ -0,0 +1,248 @@
+#include "StopWords.h"
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+namespace {
+
+// Служебные слова короче двух символов не нужны: токенизатор их и так отбрасывает.
+constexpr std::string_view ENGLISH[] = {
+    "about", "above", "after", "again", "against", "all", "am", "an", "and", "any", "are", "aren", "as", "at",
+    "be", "because", "been", "before", "being", "below", "between", "both", "but", "by", "can", "could",
+    "couldn", "did", "didn", "do", "does", "doesn", "doing", "don", "down", "during", "each", "few", "for",
+    "from", "further", "had", "hadn", "has", "hasn", "have", "haven", "having", "he", "her", "here", "hers",
+    "herself", "him", "himself", "his", "how", "if", "in", "into", "is", "isn", "it", "its", "itself", "just",
+    "ll", "me", "more", "most", "my", "myself", "no", "nor", "not", "now", "of", "off", "on", "once", "only",
+    "or", "other", "our", "ours", "ourselves", "out", "over", "own", "re", "same", "she", "should", "shouldn",
+    "so", "some", "such", "than", "that", "the", "their", "theirs", "them", "themselves", "then", "there",
+    "these", "they", "this", "those", "through", "to", "too", "under", "until", "up", "ve", "very", "was",
+    "wasn", "we", "were", "weren", "what", "when", "where", "which", "while", "who", "whom", "why", "will",
+    "with", "won", "would", "wouldn", "you", "your", "yours", "yourself", "yourselves",
+};
+
+constexpr std::string_view RUSSIAN[] = {
+    "не", "что", "он", "на", "как", "то", "все", "она", "так", "его", "но", "да", "ты", "же", "вы", "за",
+    "бы", "по", "только", "ее", "её", "мне", "было", "вот", "от", "меня", "еще", "ещё", "нет", "из", "ему",
+    "теперь", "когда", "даже", "ну", "ли", "если", "уже", "или", "ни", "быть", "был", "него", "до", "вас",
+    "нибудь", "уж", "вам", "ведь", "там", "потом", "себя", "ей", "может", "они", "тут", "где", "есть",
+    "надо", "ней", "для", "мы", "тебя", "их", "чем", "была", "сам", "чтоб", "без", "будто", "чего", "тоже",
+    "себе", "под", "будет", "тогда", "кто", "этот", "того", "потому", "этого", "какой", "ним", "здесь",
+    "этом", "мой", "тем", "чтобы", "нее", "неё", "были", "куда", "зачем", "всех", "можно", "при", "об",
+    "хоть", "после", "над", "тот", "через", "эти", "нас", "про", "всего", "них", "какая", "разве", "эту",
+    "моя", "свою", "этой", "перед", "том", "такой", "им", "более", "всю", "между", "это", "эта", "мои",
+    "свой", "своей", "своих", "свои", "ею", "нём", "нем", "вся", "весь", "всё", "ваш", "наш",
+};
+
+constexpr std::size_t tableSize(std::size_t keys) {
+    std::size_t size = 2;
+    while (size < 2 * keys) size *= 2;
+    return size;
+}
+
+// в среднем по четыре слова на корзину
+constexpr std::size_t bucketCount(std::size_t keys) {
+    std::size_t buckets = 1;
+    while (buckets * 4 < keys) buckets *= 2;
+    return buckets;
+}
+
+// Раскладывает различные keys по ячейкам cells: корзины обходятся от самых больших,
+// для каждой подбирается смещение, при котором все её слова попадают в свободные ячейки.
+// hashes, order и starts - рабочие массивы на n, n и buckets + 1 элементов.
+constexpr bool buildTable(const std::string_view *keys, std::size_t n, std::uint64_t seed,
+                          std::string_view *cells, std::size_t size, std::uint32_t *displacements,
+                          std::size_t buckets, std::uint64_t *hashes, std::uint32_t *order, std::uint32_t *starts) {
+    for (std::size_t i = 0; i < size; i++) cells[i] = std::string_view();
+    for (std::size_t b = 0; b <= buckets; b++) starts[b] = 0;
+
+    // сортировка подсчётом по корзинам
+    for (std::size_t k = 0; k < n; k++) {
+        hashes[k] = StopWordSet::hash(keys[k], seed);
+        starts[StopWordSet::bucket(hashes[k], buckets - 1) + 1]++;
+    }
+    std::uint32_t largest = 0;
+    for (std::size_t b = 0; b < buckets; b++) {
+        largest = std::max(largest, starts[b + 1]);
+        starts[b + 1] += starts[b];
+    }
+    for (std::size_t b = 0; b < buckets; b++) displacements[b] = starts[b];
+    for (std::size_t k = 0; k < n; k++) {
+        order[displacements[StopWordSet::bucket(hashes[k], buckets - 1)]++] = static_cast<std::uint32_t>(k);
+    }
+
+    for (std::uint32_t bucketSize = largest; bucketSize > 0; bucketSize--) {
+        for (std::size_t b = 0; b < buckets; b++) {
+            if (starts[b + 1] - starts[b] != bucketSize) continue;
+
+            bool placed = false;
+            for (std::uint32_t d = 0; d < size && !placed; d++) {
+                std::uint32_t k = starts[b];
+                while (k < starts[b + 1] && cells[StopWordSet::slot(hashes[order[k]], d, size - 1)].empty()) {
+                    cells[StopWordSet::slot(hashes[order[k]], d, size - 1)] = keys[order[k]];
+                    k++;
+                }
+                placed = k == starts[b + 1];
+                if (!placed) {
+                    // откатываем уже поставленные слова корзины
+                    while (k > starts[b]) {
+                        k--;
+                        cells[StopWordSet::slot(hashes[order[k]], d, size - 1)] = std::string_view();
+                    }
+                } else {
+                    displacements[b] = d;
+                }
+            }
+            if (!placed) return false;
+        }
+    }
+    for (std::size_t b = 0; b < buckets; b++) {
+        if (starts[b + 1] == starts[b]) displacements[b] = 0;
+    }
+    return true;
+}
+
+constexpr std::uint64_t MAX_SEEDS = 64;
+
+template <std::size_t N>
+struct BuiltinTable {
+    static constexpr std::size_t SIZE = tableSize(N);
+    static constexpr std::size_t BUCKETS = bucketCount(N);
+    std::array<std::string_view, SIZE> cells{};
+    std::array<std::uint32_t, BUCKETS> displacements{};
+    std::uint64_t seed = 0;
+    std::size_t maxLength = 0;
+    bool ok = false;
+};
+
+template <std::size_t N>
+constexpr BuiltinTable<N> makeTable(const std::array<std::string_view, N> &keys) {
+    BuiltinTable<N> table;
+    std::array<std::uint64_t, N> hashes{};
+    std::array<std::uint32_t, N> order{};
+    std::array<std::uint32_t, BuiltinTable<N>::BUCKETS + 1> starts{};
+
+    for (std::uint64_t seed = 0; seed < MAX_SEEDS && !table.ok; seed++) {
+        table.seed = seed;
+        table.ok = buildTable(keys.data(), N, seed, table.cells.data(), table.SIZE, table.displacements.data(),
+                              table.BUCKETS, hashes.data(), order.data(), starts.data());
+    }
+    for (std::string_view key : keys) table.maxLength = std::max(table.maxLength, key.size());
+    return table;
+}
+
+template <std::size_t A, std::size_t B>
+constexpr std::array<std::string_view, A + B> concat(const std::string_view (&a)[A], const std::string_view (&b)[B]) {
+    std::array<std::string_view, A + B> result{};
+    for (std::size_t i = 0; i < A; i++) result[i] = a[i];
+    for (std::size_t i = 0; i < B; i++) result[A + i] = b[i];
+    return result;
+}
+
+template <std::size_t N>
+constexpr std::array<std::string_view, N> toArray(const std::string_view (&a)[N]) {
+    std::array<std::string_view, N> result{};
+    for (std::size_t i = 0; i < N; i++) result[i] = a[i];
+    return result;
+}
+
+constexpr auto ENGLISH_TABLE = makeTable(toArray(ENGLISH));
+constexpr auto RUSSIAN_TABLE = makeTable(toArray(RUSSIAN));
+constexpr auto BOTH_TABLE = makeTable(concat(ENGLISH, RUSSIAN));
+// не сойдётся, только если в списке есть повторы
+static_assert(ENGLISH_TABLE.ok && RUSSIAN_TABLE.ok && BOTH_TABLE.ok, "stop word lists must not repeat words");
+
+}
+
+StopWordSet::StopWordSet(int languages) {
+    auto assign = [this](const auto &table, std::size_t words) {
+        cells.assign(table.cells.begin(), table.cells.end());
+        displacements.assign(table.displacements.begin(), table.displacements.end());
+        slotMask = table.SIZE - 1;
+        bucketMask = table.BUCKETS - 1;
+        maxLength = table.maxLength;
+        seed = table.seed;
+        count = words;
+    };
+
+    if ((languages & English) && (languages & Russian)) {
+        assign(BOTH_TABLE, std::size(ENGLISH) + std::size(RUSSIAN));
+    } else if (languages & English) {
+        assign(ENGLISH_TABLE, std::size(ENGLISH));
+    } else if (languages & Russian) {
+        assign(RUSSIAN_TABLE, std::size(RUSSIAN));
+    }
+}
+
+bool StopWordSet::loadFile(const QString &path) {
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "Error: Can`t open stop words file" << path;
+        return false;
+    }
+
+    std::vector<std::string> words;
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        words.push_back(line.toLower().toStdString());
+    }
+    addWords(words);
+    return true;
+}
+
+void StopWordSet::addWords(const std::vector<std::string> &words) {
+    // старые пользовательские слова переезжают в новый буфер вместе с новыми
+    std::vector<std::string_view> keys;
+    std::string arena;
+    std::vector<std::pair<std::size_t, std::size_t>> added;
+    for (std::string_view key : cells) {
+        if (key.empty()) continue;
+        if (userWords && key.data() >= userWords->data() && key.data() < userWords->data() + userWords->size()) {
+            added.emplace_back(arena.size(), key.size());
+            arena.append(key);
+        } else {
+            keys.push_back(key);
+        }
+    }
+    for (const std::string &word : words) {
+        if (word.empty()) continue;
+        added.emplace_back(arena.size(), word.size());
+        arena.append(word);
+    }
+
+    auto owned = std::make_shared<const std::string>(std::move(arena));
+    for (const auto &[offset, length] : added) {
+        keys.push_back(std::string_view(*owned).substr(offset, length));
+    }
+    userWords = std::move(owned);
+    rebuild(std::move(keys));
+}
+
+void StopWordSet::rebuild(std::vector<std::string_view> keys) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    const std::size_t size = tableSize(keys.size());
+    const std::size_t buckets = bucketCount(keys.size());
+    std::vector<std::uint64_t> hashes(keys.size());
+    std::vector<std::uint32_t> order(keys.size());
+    std::vector<std::uint32_t> starts(buckets + 1);
+    cells.assign(size, std::string_view());
+    displacements.assign(buckets, 0);
+
+    // встроенные списки сходятся с первых попыток; с чужими словами перебираем seed, пока не сойдётся
+    seed = 0;
+    while (!buildTable(keys.data(), keys.size(), seed, cells.data(), size, displacements.data(), buckets,
+                       hashes.data(), order.data(), starts.data())) {
+        seed++;
+    }
+
+    slotMask = size - 1;
+    bucketMask = buckets - 1;
+    count = keys.size();
+    maxLength = 0;
+    for (std::string_view key : keys) maxLength = std::max(maxLength, key.size());
+}
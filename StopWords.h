@@ -0,0 +1,72 @@
+#ifndef STOPWORDS_H
+#define STOPWORDS_H
+
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Множество стоп-слов на идеальном хэше (hash and displace): слово проверяется одним хэшем,
+// смещением его корзины и одним сравнением строк, без проб и цепочек.
+// Встроенные списки (английский и русский) раскладываются во время компиляции,
+// пользовательские добавляются при запуске тем же построителем.
+// Слова хранятся в UTF-8 в нижнем регистре, как их выдаёт Utf8Tokenizer.
+class StopWordSet {
+public:
+    enum Language { English = 1, Russian = 2 };
+
+    StopWordSet() = default;
+    // languages - сочетание флагов Language; таблица копируется из готовой constexpr
+    explicit StopWordSet(int languages);
+
+    // Слова по одному на строку, пустые строки и строки с # пропускаются; регистр приводится к нижнему.
+    bool loadFile(const QString &path);
+    void addWords(const std::vector<std::string> &words);
+
+    bool contains(std::string_view word) const {
+        if (word.empty() || word.size() > maxLength) return false;
+        const std::uint64_t h = hash(word, seed);
+        return cells[slot(h, displacements[bucket(h, bucketMask)], slotMask)] == word;
+    }
+
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+
+    static constexpr std::uint64_t hash(std::string_view word, std::uint64_t seed) {
+        // FNV-1a и перемешивание из MurmurHash3: у коротких слов FNV плохо заполняет старшие биты
+        std::uint64_t h = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+        for (char c : word) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+    static constexpr std::size_t bucket(std::uint64_t h, std::size_t mask) {
+        return static_cast<std::size_t>(h >> 40) & mask;
+    }
+    // шаг нечётный, поэтому смещения 0..size-1 обходят все ячейки
+    static constexpr std::size_t slot(std::uint64_t h, std::uint32_t displacement, std::size_t mask) {
+        return static_cast<std::size_t>(h + displacement * ((h >> 32) | 1)) & mask;
+    }
+
+private:
+    std::vector<std::string_view> cells = {std::string_view()};
+    std::vector<std::uint32_t> displacements = {0};
+    std::size_t slotMask = 0;
+    std::size_t bucketMask = 0;
+    std::size_t maxLength = 0;
+    std::size_t count = 0;
+    std::uint64_t seed = 0;
+    // пользовательские слова: таблица ссылается на них, копии множества делят один буфер
+    std::shared_ptr<const std::string> userWords;
+
+    void rebuild(std::vector<std::string_view> keys);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "TiledRenderer.h"
+#include "GlyphCache.h"
+#include <QPainter>
+#include <QIODevice>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TiledRenderer::TiledRenderer(const Layout &layout, const QSize &size, int tileSize, int threads)
+    : layout(layout), size(size), tileSize(std::max(16, tileSize)), threads(std::max(1, threads)) {}
+
+bool TiledRenderer::render(const BandSink &sink) const {
+    if (size.isEmpty()) return false;
+
+    const int columns = (size.width() + tileSize - 1) / tileSize;
+    const int workers = std::min(threads, columns);
+    // кэш глифов на поток: QStaticText нельзя разбирать из нескольких потоков сразу
+    std::vector<GlyphCache> caches(workers);
+    QImage band(size.width(), std::min(tileSize, size.height()), QImage::Format_ARGB32);
+
+    for (int y = 0; y < size.height(); y += tileSize) {
+        const int bandHeight = std::min(tileSize, size.height() - y);
+        std::atomic<int> next{0};
+        // bits() может отсоединить данные полосы, поэтому вызывается здесь, а не в потоках
+        uchar *bits = band.bits();
+        const qsizetype stride = band.bytesPerLine();
+
+        auto worker = [&](int index) {
+            for (int column = next++; column < columns; column = next++) {
+                const int x = column * tileSize;
+                const int tileWidth = std::min(tileSize, size.width() - x);
+                // плитка - окно в буфер полосы, плитки не пересекаются, так что потоки друг другу не мешают
+                QImage tile(bits + x * 4, tileWidth, bandHeight, stride, QImage::Format_ARGB32);
+                tile.fill(Qt::white);
+
+                QPainter painter(&tile);
+                painter.translate(-x, -y);
+                layout.render(&painter, size, &caches[index], QRectF(x, y, tileWidth, bandHeight));
+                painter.end();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (int t = 1; t < workers; t++) {
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto &thread : pool) {
+            thread.join();
+        }
+
+        const QImage rows = bandHeight == band.height() ? band : band.copy(0, 0, size.width(), bandHeight);
+        if (!sink(rows, y)) return false;
+    }
+    return true;
+}
+
+bool TiledRenderer::writeBmp(QIODevice &device) const {
+    const quint64 stride = (static_cast<quint64>(size.width()) * 3 + 3) & ~quint64(3);
+    const quint64 fileSize = 54 + stride * size.height();
+    if (fileSize > 0xFFFFFFFFull) return false;
+
+    // BITMAPFILEHEADER + BITMAPINFOHEADER; отрицательная высота - строки сверху вниз
+    char header[54] = {'B', 'M'};
+    qToLittleEndian(static_cast<quint32>(fileSize), header + 2);
+    qToLittleEndian(static_cast<quint32>(54), header + 10);
+    qToLittleEndian(static_cast<quint32>(40), header + 14);
+    qToLittleEndian(static_cast<qint32>(size.width()), header + 18);
+    qToLittleEndian(static_cast<qint32>(-size.height()), header + 22);
+    qToLittleEndian(static_cast<quint16>(1), header + 26);
+    qToLittleEndian(static_cast<quint16>(24), header + 28);
+    qToLittleEndian(static_cast<quint32>(stride * size.height()), header + 34);
+    if (device.write(header, sizeof(header)) != qint64(sizeof(header))) return false;
+
+    QByteArray row(static_cast<qsizetype>(stride), '\0');
+    return render([&](const QImage &band, int) {
+        for (int line = 0; line < band.height(); line++) {
+            const QRgb *pixels = reinterpret_cast<const QRgb *>(band.constScanLine(line));
+            char *out = row.data();
+            for (int x = 0; x < band.width(); x++) {
+                *out++ = static_cast<char>(qBlue(pixels[x]));
+                *out++ = static_cast<char>(qGreen(pixels[x]));
+                *out++ = static_cast<char>(qRed(pixels[x]));
+            }
+            if (device.write(row) != row.size()) return false;
+        }
+        return true;
+    });
+}
@@ -0,0 +1,36 @@
+#ifndef TILEDRENDERER_H
+#define TILEDRENDERER_H
+
+#include <QImage>
+#include <QSize>
+#include <functional>
+#include "Layout.h"
+
+class QIODevice;
+
+// Отрисовка больших картинок плитками. Холст режется на полосы высотой в плитку, плитки полосы
+// рисуются параллельно своими QPainter прямо в общий буфер полосы, готовая полоса отдаётся
+// потребителю и буфер переиспользуется. Память - одна полоса (ширина x плитка), а не вся картинка.
+// Пиксели совпадают с Layout::toImage: каждая плитка рисует ту же раскладку со сдвигом на целое число пикселей.
+class TiledRenderer {
+public:
+    // Получает очередную полосу и её верхнюю строку; false прерывает отрисовку.
+    using BandSink = std::function<bool(const QImage &band, int y)>;
+
+    TiledRenderer(const Layout &layout, const QSize &size, int tileSize = DEFAULT_TILE_SIZE, int threads = 1);
+
+    bool render(const BandSink &sink) const;
+
+    // Пишет картинку в 24-битный BMP построчно, не собирая её в памяти целиком.
+    bool writeBmp(QIODevice &device) const;
+
+    static constexpr int DEFAULT_TILE_SIZE = 1024;
+
+private:
+    const Layout &layout;
+    QSize size;
+    int tileSize;
+    int threads;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "TokenNormalizer.h"
+
+namespace {
+
+constexpr std::size_t MIN_STEM_LETTERS = 3;
+
+// Окончания по убыванию длины: отрезается первое подходящее.
+constexpr std::string_view RUSSIAN_ENDINGS[] = {
+    "иями", "ться",
+    "ями", "ами", "ого", "его", "ому", "ему", "ыми", "ими", "иях", "ией", "ешь", "ишь",
+    "ой", "ей", "ый", "ий", "ая", "яя", "ое", "ее", "ые", "ие", "ую", "юю", "ом", "ем", "ам", "ям", "ах", "ях",
+    "ов", "ев", "ия", "ию", "ть", "ет", "ит", "ут", "ют", "ат", "ят", "ла", "ли", "ло", "ся",
+    "а", "я", "о", "е", "ы", "и", "у", "ю", "ь", "й",
+};
+
+std::size_t letters(std::string_view word) {
+    std::size_t n = 0;
+    for (char c : word) n += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    return n;
+}
+
+bool endsWith(std::string_view word, std::string_view ending) {
+    return word.size() > ending.size() && word.compare(word.size() - ending.size(), ending.size(), ending) == 0;
+}
+
+// английское множественное число (S-stemmer Хармана без замены ies -> y)
+std::string_view stemEnglish(std::string_view word) {
+    if (endsWith(word, "sses")) return word.substr(0, word.size() - 2);
+    if (endsWith(word, "es") && word.size() >= 5) {
+        const std::string_view stem = word.substr(0, word.size() - 2);
+        if (endsWith(stem, "x") || endsWith(stem, "z") || endsWith(stem, "ch") || endsWith(stem, "sh")) return stem;
+    }
+    if (endsWith(word, "s") && !endsWith(word, "ss") && !endsWith(word, "us") && !endsWith(word, "is")
+        && word.size() > MIN_STEM_LETTERS) {
+        return word.substr(0, word.size() - 1);
+    }
+    return word;
+}
+
+}
+
+std::string_view lightStem(std::string_view word) {
+    if (word.empty()) return word;
+
+    if (static_cast<unsigned char>(word.back()) < 0x80) return stemEnglish(word);
+
+    for (std::string_view ending : RUSSIAN_ENDINGS) {
+        if (endsWith(word, ending)) {
+            const std::string_view stem = word.substr(0, word.size() - ending.size());
+            if (letters(stem) >= MIN_STEM_LETTERS) return stem;
+        }
+    }
+    return word;
+}
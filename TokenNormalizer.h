@@ -0,0 +1,105 @@
+#ifndef TOKENNORMALIZER_H
+#define TOKENNORMALIZER_H
+
+#include <cstddef>
+#include <string_view>
+#include <tuple>
+#include "StopWords.h"
+
+// Этапы обработки слов после токенизатора. Этап - класс с bool operator()(std::string_view &word):
+// false отбрасывает слово, а сам этап может укоротить word (например, отрезать окончание).
+// Этапы собираются в NormalizerChain во время компиляции, так что на каждое слово
+// нет ни виртуальных вызовов, ни проверок выключенных этапов.
+
+// Не короче chars символов (байты продолжения UTF-8 не считаются).
+struct MinLengthFilter {
+    std::size_t chars;
+    bool operator()(std::string_view &word) const {
+        if (word.size() >= 2 * chars) return true;  // в словах символы занимают не больше 2 байт
+        std::size_t n = 0;
+        for (char c : word) n += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+        return n >= chars;
+    }
+};
+
+struct StopWordFilter {
+    const StopWordSet *words;
+    bool operator()(std::string_view &word) const { return !words->contains(word); }
+};
+
+// Лёгкий стеммер: отрезает одно частое окончание (русские падежные и глагольные,
+// английское множественное число), оставляя основу не короче трёх букв.
+std::string_view lightStem(std::string_view word);
+
+struct LightStemmer {
+    bool operator()(std::string_view &word) const {
+        word = lightStem(word);
+        return true;
+    }
+};
+
+template <typename... Stages>
+class NormalizerChain {
+public:
+    explicit NormalizerChain(Stages... stages) : stages(stages...) {}
+
+    bool operator()(std::string_view &word) const {
+        return std::apply([&word](const Stages &...stage) { return (stage(word) && ...); }, stages);
+    }
+
+private:
+    std::tuple<Stages...> stages;
+};
+
+// Настройки этапов. dispatch выбирает цепочку из включённых этапов один раз и передаёт её fn,
+// а fn прогоняет через неё все слова буфера.
+class TokenNormalizer {
+public:
+    // меньше 3 символов ничего не меняет: короткие слова токенизатор отбрасывает сам
+    void setMinLength(int chars) { minChars = chars > 2 ? static_cast<std::size_t>(chars) : 0; }
+    void setStopWords(StopWordSet words) { stopWords = std::move(words); }
+    void setStemming(bool enabled) { stemming = enabled; }
+
+    int minLength() const { return static_cast<int>(minChars); }
+    const StopWordSet &stops() const { return stopWords; }
+    bool stems() const { return stemming; }
+    bool active() const { return minChars > 0 || !stopWords.empty() || stemming; }
+
+    template <typename Fn>
+    void dispatch(Fn &&fn) const {
+        auto withStemmer = [&](auto... stages) {
+            if (stemming) {
+                fn(NormalizerChain<decltype(stages)..., LightStemmer>(stages..., LightStemmer{}));
+            } else {
+                fn(NormalizerChain<decltype(stages)...>(stages...));
+            }
+        };
+        auto withStopWords = [&](auto... stages) {
+            if (!stopWords.empty()) {
+                withStemmer(stages..., StopWordFilter{&stopWords});
+            } else {
+                withStemmer(stages...);
+            }
+        };
+        if (minChars > 0) {
+            withStopWords(MinLengthFilter{minChars});
+        } else {
+            withStopWords();
+        }
+    }
+
+    // Для одиночных слов (addWord): выбирает цепочку на каждый вызов, в горячих циклах - dispatch.
+    bool apply(std::string_view &word) const {
+        if (!active()) return true;
+        bool keep = true;
+        dispatch([&](const auto &chain) { keep = chain(word); });
+        return keep;
+    }
+
+private:
+    std::size_t minChars = 0;
+    StopWordSet stopWords;
+    bool stemming = false;
+};
+
+#endif
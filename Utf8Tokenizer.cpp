@@ -0,0 +1,299 @@
+#include "Utf8Tokenizer.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define WORDCLOUD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define WORDCLOUD_TARGET_AVX2
+#else
+#define WORDCLOUD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+struct BlockMasks {
+    std::uint32_t word;
+    std::uint32_t high;
+};
+
+inline unsigned countTrailingZeros(std::uint32_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(v));
+#endif
+}
+
+inline bool isAsciiWord(unsigned char c) {
+    return static_cast<unsigned char>(c - 'a') < 26 || static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline unsigned char asciiLower(unsigned char c) {
+    return static_cast<unsigned char>(c - 'A') < 26 ? static_cast<unsigned char>(c | 0x20) : c;
+}
+
+inline bool isContinuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+#ifdef WORDCLOUD_X86
+
+inline BlockMasks classifySse2(char *p) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    // сравнения знаковые, поэтому байты >= 0x80 ни в один диапазон не попадают
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)),
+                                        _mm_cmplt_epi8(bytes, _mm_set1_epi8('Z' + 1)));
+    bytes = _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), bytes);
+
+    const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('a' - 1)),
+                                         _mm_cmplt_epi8(bytes, _mm_set1_epi8('z' + 1)));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)),
+                                        _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+
+    return {static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(letter, digit))),
+            static_cast<std::uint32_t>(_mm_movemask_epi8(bytes))};
+}
+
+WORDCLOUD_TARGET_AVX2 BlockMasks classifyAvx2(char *p) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+    bytes = _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), bytes);
+
+    const __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('a' - 1)),
+                                            _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), bytes));
+    const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+
+    return {static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(letter, digit))),
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(bytes))};
+}
+
+#endif
+
+class Scanner {
+public:
+    Scanner(char *data, std::size_t size, std::vector<std::string_view> &words, std::deque<std::string> &rewritten)
+        : data(data), size(size), words(words), rewritten(rewritten) {}
+
+    template <std::size_t Width, BlockMasks (*Classify)(char *)>
+    void run() {
+        std::size_t i = 0;
+        while (i < size) {
+            if (copy != nullptr || i + Width > size) {
+                i = step(i);
+                continue;
+            }
+
+            const BlockMasks masks = Classify(data + i);
+            // блок обрабатываем до первого не-ASCII байта, его разбирает step()
+            const std::size_t limit = masks.high ? countTrailingZeros(masks.high) : Width;
+            const std::uint64_t inBlock = (std::uint64_t(1) << limit) - 1;
+            std::size_t pos = 0;
+
+            while (pos < limit) {
+                const std::uint64_t range = inBlock & ~((std::uint64_t(1) << pos) - 1);
+                const std::uint32_t candidates = static_cast<std::uint32_t>((inWord ? ~masks.word : masks.word) & range);
+                if (candidates == 0) break;
+
+                const std::size_t at = countTrailingZeros(candidates);
+                if (inWord) {
+                    finish(i + at);
+                } else {
+                    begin(i + at);
+                }
+                pos = at + 1;
+            }
+
+            i += limit;
+            if (limit < Width) i = step(i);
+        }
+        finish(size);
+    }
+
+    void runScalar() {
+        std::size_t i = 0;
+        while (i < size) i = step(i);
+        finish(size);
+    }
+
+private:
+    char *data;
+    std::size_t size;
+    std::vector<std::string_view> &words;
+    std::deque<std::string> &rewritten;
+    std::size_t wordStart = 0;
+    bool inWord = false;
+    std::string *copy = nullptr;
+
+    void begin(std::size_t at) {
+        if (inWord) return;
+        inWord = true;
+        wordStart = at;
+    }
+
+    void finish(std::size_t end) {
+        if (!inWord) return;
+        inWord = false;
+        if (copy != nullptr) {
+            output(*copy);
+            copy = nullptr;
+        } else {
+            output(std::string_view(data + wordStart, end - wordStart));
+        }
+    }
+
+    void output(std::string_view word) {
+        // символы слова занимают 1 (ASCII) или 2 (кириллица) байта: 2 байта - это 2 символа только для ASCII
+        if (word.size() >= 3 || (word.size() == 2 && static_cast<unsigned char>(word[0]) < 0x80)) {
+            words.push_back(word);
+        }
+    }
+
+    void append(std::size_t at, std::size_t length) {
+        begin(at);
+        if (copy != nullptr) copy->append(data + at, length);
+    }
+
+    // Разбирает один символ с позиции i и возвращает позицию следующего.
+    std::size_t step(std::size_t i) {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+
+        if (c < 0x80) {
+            const unsigned char lower = asciiLower(c);
+            data[i] = static_cast<char>(lower);
+            if (isAsciiWord(lower)) {
+                append(i, 1);
+            } else {
+                finish(i);
+            }
+            return i + 1;
+        }
+
+        if ((c == 0xD0 || c == 0xD1 || c == 0xC4) && i + 1 < size
+            && isContinuation(static_cast<unsigned char>(data[i + 1]))) {
+            const unsigned char c2 = static_cast<unsigned char>(data[i + 1]);
+            unsigned char lead = c;
+            unsigned char tail = c2;
+            bool word = false;
+
+            if (c == 0xD0 && c2 == 0x81) {                  // Ё -> ё
+                lead = 0xD1;
+                tail = 0x91;
+                word = true;
+            } else if (c == 0xD0 && c2 >= 0x90 && c2 <= 0x9F) {  // А-П -> а-п
+                tail = static_cast<unsigned char>(c2 + 0x20);
+                word = true;
+            } else if (c == 0xD0 && c2 >= 0xA0 && c2 <= 0xAF) {  // Р-Я -> р-я
+                lead = 0xD1;
+                tail = static_cast<unsigned char>(c2 - 0x20);
+                word = true;
+            } else if (c == 0xD0 && c2 >= 0xB0) {           // а-п
+                word = true;
+            } else if (c == 0xD1 && (c2 <= 0x8F || c2 == 0x91)) {  // р-я, ё
+                word = true;
+            } else if (c == 0xC4 && c2 == 0xB0) {
+                // İ в нижнем регистре - это "i" и комбинирующая точка, которая обрывает слово
+                data[i] = 'i';
+                append(i, 1);
+                finish(i + 1);
+                return i + 2;
+            }
+
+            if (word) {
+                data[i] = static_cast<char>(lead);
+                data[i + 1] = static_cast<char>(tail);
+                append(i, 2);
+            } else {
+                finish(i);
+            }
+            return i + 2;
+        }
+
+        if (c == 0xE2 && i + 2 < size && static_cast<unsigned char>(data[i + 1]) == 0x84
+            && static_cast<unsigned char>(data[i + 2]) == 0xAA) {
+            // знак кельвина превращается в однобайтовую "k", поэтому дальше слово собирается в копию
+            if (copy == nullptr) {
+                rewritten.emplace_back(inWord ? std::string(data + wordStart, i - wordStart) : std::string());
+                copy = &rewritten.back();
+            }
+            begin(i);
+            copy->push_back('k');
+            return i + 3;
+        }
+
+        // любой другой не-ASCII байт - разделитель; продолжения многобайтовых
+        // последовательностей не совпадают с ведущими байтами выше, так что разбор не сбивается
+        finish(i);
+        return i + 1;
+    }
+};
+
+Utf8Tokenizer::Simd detectCpu() {
+#ifdef WORDCLOUD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        if (osSavesYmm && (info[1] & (1 << 5))) return Utf8Tokenizer::Simd::Avx2;
+    }
+    return Utf8Tokenizer::Simd::Sse2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Utf8Tokenizer::Simd::Avx2;
+    if (__builtin_cpu_supports("sse2")) return Utf8Tokenizer::Simd::Sse2;
+    return Utf8Tokenizer::Simd::Scalar;
+#endif
+#else
+    return Utf8Tokenizer::Simd::Scalar;
+#endif
+}
+
+}
+
+Utf8Tokenizer::Simd Utf8Tokenizer::detectSimd() {
+    static const Simd detected = detectCpu();
+    return detected;
+}
+
+const char *Utf8Tokenizer::simdName(Simd level) {
+    switch (level) {
+    case Simd::Avx2: return "avx2";
+    case Simd::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+bool Utf8Tokenizer::isSeparator(char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return u < 0x80 && !isAsciiWord(asciiLower(u));
+}
+
+void Utf8Tokenizer::tokenize(char *data, std::size_t size, std::vector<std::string_view> &words) {
+    rewrittenWords.clear();
+    Scanner scanner(data, size, words, rewrittenWords);
+
+    switch (simd) {
+#ifdef WORDCLOUD_X86
+    case Simd::Avx2:
+        scanner.run<32, classifyAvx2>();
+        break;
+    case Simd::Sse2:
+        scanner.run<16, classifySse2>();
+        break;
+#endif
+    default:
+        scanner.runScalar();
+        break;
+    }
+}
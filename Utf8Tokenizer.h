@@ -0,0 +1,36 @@
+#ifndef UTF8TOKENIZER_H
+#define UTF8TOKENIZER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Токенизатор, работающий прямо с байтами UTF-8. Выдаёт те же слова, что и
+// text.toLower().split(QRegularExpression("[^a-zа-яё0-9]+")) с отбросом слов короче 2 символов.
+// ASCII классифицируется и приводится к нижнему регистру блоками по 16/32 байта (SSE2/AVX2),
+// кириллица и прочие многобайтовые символы разбираются скалярно.
+class Utf8Tokenizer {
+public:
+    enum class Simd { Scalar, Sse2, Avx2 };
+
+    explicit Utf8Tokenizer(Simd level = detectSimd()) : simd(level) {}
+
+    // Приводит data к нижнему регистру на месте и дописывает в words найденные слова.
+    // Слова указывают внутрь data и действительны, пока data не изменён и не вызван следующий tokenize.
+    void tokenize(char *data, std::size_t size, std::vector<std::string_view> &words);
+
+    Simd level() const { return simd; }
+
+    static Simd detectSimd();
+    static const char *simdName(Simd level);
+    static bool isSeparator(char c);
+
+private:
+    Simd simd;
+    // слова с символом K (U+212A): после приведения он короче, поэтому такие слова собираются в копию
+    std::deque<std::string> rewrittenWords;
+};
+
+#endif
@@ -8,7 +8,15 @@
 #include <QFont>           
 #include <QFontMetrics>    
 #include <QRandomGenerator>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
 #include <vector>
+#include <thread>
+#include <cstring>
+#include "Utf8Tokenizer.h"
+#include "CountSnapshot.h"
+#include "Profiler.h"
 
 const std::vector<QColor> WordCloudGenerator::COLORS = {
     QColor(231, 76, 60),   
@@ -20,341 +28,590 @@ const std::vector<QColor> WordCloudGenerator::COLORS = {
     QColor(22, 160, 133)   
 };
 
+const QStringList &WordCloudGenerator::shapes() {
+    return shapeNames();
+}
+
 void WordCloudGenerator::processText(const QString &text) { 
-    freq.clear();
+    clear();
+    
+    if (threadCount > 1 || approx) {
+        QByteArray bytes = text.toUtf8();
+        std::vector<WordCountTable> shards(threadCount);
+        countBuffer(bytes.data(), bytes.size(), true, shards);
+        mergeShards(shards);
+        return;
+    }
+    
+    QString lower;
+    {
+        Profiler::Scope scope(Profiler::Stage::Lower);
+        lower = text.toLower();
+    }
     
-    QStringList words = text.toLower().split(QRegularExpression("[^a-zа-яё0-9]+"), Qt::SkipEmptyParts);
+    QStringList words;
+    {
+        Profiler::Scope scope(Profiler::Stage::Split);
+        words = lower.split(QRegularExpression("[^a-zа-яё0-9]+"), Qt::SkipEmptyParts);
+    }
+    Profiler::add(Profiler::Counter::Tokens, words.size());
     
+    Profiler::Scope scope(Profiler::Stage::Count);
     for (auto &w : words) {
-        if (w.length() < 2) continue;
-        freq[w]++;
+        addWord(w);
     }
 }
 
-void WordCloudGenerator::draw(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
-    if (drawing_shape == "circle") {
-        drawCircle(p, size);
-    } else if (drawing_shape == "spiral") {
-        drawSpiral(p, size);
-    } else if (drawing_shape == "square") {
-        drawSquare(p, size);
-    } else if (drawing_shape == "triangle") {
-        drawTriangle(p, size);
-    } else if (drawing_shape == "heart") {
-        drawHeart(p, size);
-    } else if (drawing_shape == "star") {
-        drawStar(p, size);
-    } else {
-        drawSpiral(p, size);  
-    }
+void WordCloudGenerator::clear() {
+    freq.clear();
+    if (approx) approx->clear();
+    rankIndex.clear();
+    rankIndexActive = false;
+    invalidateRanking();
 }
 
-QColor WordCloudGenerator::getRandomColor() { 
-    int i = rand() % COLORS.size();
-    return COLORS[i];
+bool WordCloudGenerator::saveCounts(const QString &path) const {
+    if (!approx) return CountSnapshot::save(path, freq);
+    
+    WordCountTable estimates;
+    for (const HeavyHitters::Item &item : approx->top(approx->size())) {
+        estimates.add(item.word, item.count);
+    }
+    return CountSnapshot::save(path, estimates);
 }
 
-void WordCloudGenerator::drawBasic(QPainter *p, const QSize &size, 
-                                    const std::vector<QPoint> &positions,
-                                    const QString &fontName,
-                                    int baseFontSize,
-                                    int fontMultiplier) {
-    if (freq.empty() || positions.empty()) return;
-    
-    std::vector<std::pair<QString, int>> sortedWords(freq.begin(), freq.end());
-    std::sort(sortedWords.begin(), sortedWords.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+bool WordCloudGenerator::loadCounts(const QString &path) {
+    clear();
     
-    int maxWords = std::min(static_cast<int>(sortedWords.size()), static_cast<int>(positions.size()));
+    CountSnapshot snapshot;
+    if (!snapshot.open(path)) return false;
     
-    for (int i = 0; i < maxWords; i++) {
-        const auto &word = sortedWords[i].first;
-        int frequency = sortedWords[i].second;
-        
-        int fontSize = baseFontSize;
-        if (sortedWords[0].second > 0) {
-            fontSize = baseFontSize + (frequency * fontMultiplier) / (sortedWords[0].second + 1);
+    if (!approx) freq.reserve(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        if (approx) {
+            approx->add(snapshot.word(i), snapshot.count(i));
+        } else {
+            freq.add(snapshot.word(i), snapshot.count(i));
         }
-        fontSize = std::max(MIN_FONT_SIZE, std::min(MAX_FONT_SIZE, fontSize));
-        
-        QFont font(fontName, fontSize, QFont::Bold);
-        QFontMetrics fm(font);
-        int wordWidth = fm.horizontalAdvance(word);
-        
-        int x = positions[i].x() - wordWidth / 2;
-        int y = positions[i].y() + fontSize / 3;
-        
-        x = std::max(10, std::min(x, size.width() - wordWidth - 10));
-        y = std::max(fontSize, std::min(y, size.height() - 10));
-        
-        QColor color = getRandomColor();
-        
-        p->setPen(QColor(0, 0, 0, 80));
-        p->setFont(font);
-        p->drawText(x + 1, y + 1, word);
-        p->setPen(color);
-        p->drawText(x, y, word);
     }
+    return true;
 }
 
-void WordCloudGenerator::drawSpiral(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
-    
-    int maxWords = std::min(static_cast<int>(freq.size()), MAX_WORDS_SPIRAL);
-    
-    std::vector<QPoint> positions;
-    int centerX = size.width() / 2;
-    int centerY = size.height() / 2;
-    int radius = std::min(size.width(), size.height()) * CIRCLE_RADIUS_RATIO;
+void WordCloudGenerator::addWord(QStringView word) {
+    if (word.length() < 2) return;
+
+    // слова состоят из латиницы, цифр и кириллицы, так что хватает 1-2 байт на символ
+    utf8Word.clear();
+    for (QChar c : word) {
+        const char16_t u = c.unicode();
+        if (u < 0x80) {
+            utf8Word.push_back(static_cast<char>(u));
+        } else if (u < 0x800) {
+            utf8Word.push_back(static_cast<char>(0xC0 | (u >> 6)));
+            utf8Word.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+        } else {
+            const QByteArray bytes = word.toUtf8();
+            utf8Word.assign(bytes.constData(), bytes.size());
+            break;
+        }
+    }
     
-    for (int i = 0; i < maxWords; i++) {
-        double angle = 4 * M_PI * i / maxWords;
-        double r = radius * (SPIRAL_INNER_RATIO + SPIRAL_OUTER_RATIO * (i / double(maxWords)));
-        
-        int x = centerX + static_cast<int>(r * cos(angle));
-        int y = centerY + static_cast<int>(r * sin(angle));
-        positions.push_back(QPoint(x, y));
+    std::string_view normalized = utf8Word;
+    if (!normalizer.apply(normalized)) {
+        Profiler::add(Profiler::Counter::Filtered);
+        return;
     }
+    invalidateRanking();
     
-    drawBasic(p, size, positions, "Arial", BASE_FONT_SIZE_SPIRAL, 16);
+    if (approx) {
+        approx->add(normalized);
+    } else if (rankIndexActive) {
+        changeCount(normalized, 1);
+    } else {
+        freq.add(normalized);
+    }
 }
 
-void WordCloudGenerator::drawCircle(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
-    
-    int maxWords = std::min(static_cast<int>(freq.size()), MAX_WORDS_CIRCLE);
+void WordCloudGenerator::applyDelta(QByteArray utf8, int sign) {
+    if (approx && sign < 0) return;
     
-    std::vector<QPoint> positions;
-    int centerX = size.width() / 2;
-    int centerY = size.height() / 2;
-    int radius = std::min(size.width(), size.height()) * CIRCLE_RADIUS_RATIO;
-    
-    for (int i = 0; i < maxWords; i++) {
-        double angle = 2 * M_PI * i / maxWords;
-        int x = centerX + static_cast<int>(radius * cos(angle));
-        int y = centerY + static_cast<int>(radius * sin(angle));
-        positions.push_back(QPoint(x, y));
+    if (!rankIndexActive && !approx) {
+        // один раз строим индекс по текущим частотам, дальше он обновляется по словам
+        freq.forEach([&](std::string_view word, WordCountTable::Count n) { rankIndex.insert({n, std::string(word)}); });
+        rankIndexActive = true;
     }
-    
-    drawBasic(p, size, positions, "Arial", BASE_FONT_SIZE_CIRCLE, 18);
-}
 
-void WordCloudGenerator::drawSquare(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
-    
-    int maxWords = std::min(static_cast<int>(freq.size()), MAX_WORDS_SQUARE);
+    Utf8Tokenizer tokenizer;
+    std::vector<std::string_view> words;
+    tokenizer.tokenize(utf8.data(), static_cast<size_t>(utf8.size()), words);
 
-    std::vector<QPoint> positions;
-    int length = std::min(size.width(), size.height()) * 2 / 3;
-    int startX = (size.width() - length) / 2;
-    int startY = (size.height() - length) / 2;
-    int endX = startX + length;
-    int endY = startY + length;
-    
-    double perimeter = 4.0 * length;
-    double pause = perimeter / maxWords;
-    
-    for (int i = 0; i < maxWords; i++) {
-        double pos = i * pause;
-        int x, y;
-        
-        if (pos < length) {
-            x = startX + static_cast<int>(pos);
-            y = startY;
-        } else if (pos < 2 * length) {
-            x = endX;
-            y = startY + static_cast<int>(pos - length);
-        } else if (pos < 3 * length) {
-            x = endX - static_cast<int>(pos - 2 * length);
-            y = endY;
-        } else {
-            x = startX;
-            y = endY - static_cast<int>(pos - 3 * length);
+    WordCountTable delta;
+    normalizer.dispatch([&](const auto &chain) {
+        for (std::string_view word : words) {
+            if (chain(word)) delta.add(word);
         }
-        
-        positions.push_back(QPoint(x, y));
+    });
+    if (approx) {
+        delta.forEach([&](std::string_view word, WordCountTable::Count n) { approx->add(word, n); });
+        invalidateRanking();
+        return;
     }
+    delta.forEach([&](std::string_view word, WordCountTable::Count n) { changeCount(word, sign * n); });
 
-    drawBasic(p, size, positions, "Arial", BASE_FONT_SIZE_SQUARE, 20);
+    // слова, ушедшие из окна, остаются в таблице с нулём; чистим, когда их больше, чем живых
+    if (freq.zeroEntries() > freq.size() + MIN_COMPACT_ENTRIES) {
+        freq.compact();
+    }
 }
 
-void WordCloudGenerator::drawTriangle(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
+void WordCloudGenerator::changeCount(std::string_view word, WordCountTable::Count delta) {
+    const std::uint64_t hash = WordCountTable::hash(word);
+    const WordCountTable::Count old = freq.count(word, hash);
+    delta = std::max(delta, -old);
+    if (delta == 0) return;
 
-    int maxWords = std::min(static_cast<int>(freq.size()), MAX_WORDS_TRIANGLE);
-    
-    std::vector<QPoint> positions;
-    int centerX = size.width() / 2;
-    int centerY = size.height() / 2;
-    int height = std::min(size.width(), size.height()) / 2;
-    int base = height * 1.5;
-    
-    int topX = centerX;
-    int topY = centerY - height / 2;
-    int leftX = centerX - base / 2;
-    int leftY = centerY + height / 2;
-    int rightX = centerX + base / 2;
-    int rightY = centerY + height / 2;
-
-    double sideRight = sqrt(pow(rightX - topX, 2) + pow(rightY - topY, 2));
-    double sideLeft = sqrt(pow(topX - leftX, 2) + pow(topY - leftY, 2));
-    double sideBase = rightX - leftX;
-    
-    double perimeter = sideRight + sideLeft + sideBase;
-    double pause = perimeter / maxWords;
-    
-    for (int i = 0; i < maxWords; i++) {
-        double pos = i * pause;
-        int x, y;
-        
-        if (pos < sideRight) {
-            double ratio = pos / sideRight;
-            x = static_cast<int>(topX + (rightX - topX) * ratio);
-            y = static_cast<int>(topY + (rightY - topY) * ratio);
-        } else if (pos < sideRight + sideBase) {
-            double ratio = (pos - sideRight) / sideBase;
-            x = static_cast<int>(rightX - (rightX - leftX) * ratio);
-            y = rightY;
-        } else {
-            double ratio = (pos - sideRight - sideBase) / sideLeft;
-            x = static_cast<int>(leftX + (topX - leftX) * ratio);
-            y = static_cast<int>(leftY + (topY - leftY) * ratio);
-        }
-        
-        positions.push_back(QPoint(x, y));
+    freq.add(word, hash, delta);
+    invalidateRanking();
+
+    if (!rankIndexActive) return;
+    if (old > 0) {
+        rankIndex.erase(RankKey{old, std::string(word)});
+    }
+    if (old + delta > 0) {
+        rankIndex.insert(RankKey{old + delta, std::string(word)});
     }
-    
-    drawBasic(p, size, positions, "Arial", BASE_FONT_SIZE_TRIANGLE, 20);
 }
 
-void WordCloudGenerator::drawHeart(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
+qsizetype WordCloudGenerator::countBuffer(char *data, qsizetype size, bool final, std::vector<WordCountTable> &shards) const {
+    qsizetype cut = size;
+    if (!final) {
+        // после последнего ASCII-разделителя может оказаться начало слова или обрезанный символ
+        while (cut > 0 && !Utf8Tokenizer::isSeparator(data[cut - 1])) cut--;
+    }
 
-    int maxWords = std::min(static_cast<int>(freq.size()), MAX_WORDS_HEART);
-    
-    std::vector<QPoint> positions;
-    int centerX = size.width() / 2;
-    int centerY = size.height() / 2;
-    int heartSize = std::min(size.width(), size.height()) / 3;
-    
-    std::vector<QPoint> heartPoints;
-    int numPoints = 200;
-    
-    for (int i = 0; i < numPoints; i++) {
-        double t = 2.0 * M_PI * i / numPoints;
-        
-        double x = 16.0 * pow(sin(t), 3.0);
-        double y = 13.0 * cos(t) - 5.0 * cos(2.0*t) - 2.0 * cos(3.0*t) - cos(4.0*t);
-        
-        int px = centerX + static_cast<int>((x * heartSize) / 17.0);
-        int py = centerY - static_cast<int>((y * heartSize) / 17.0);
-        
-        heartPoints.push_back(QPoint(px, py));
+    // куски режем только по разделителям, чтобы ни одно слово не попало в два куска
+    const qsizetype parts = static_cast<qsizetype>(shards.size());
+    std::vector<qsizetype> bounds(parts + 1, cut);
+    bounds[0] = 0;
+    for (qsizetype t = 1; t < parts; t++) {
+        qsizetype pos = std::max(bounds[t - 1], cut * t / parts);
+        while (pos < cut && !Utf8Tokenizer::isSeparator(data[pos])) pos++;
+        bounds[t] = pos;
     }
-    
-    heartPoints.push_back(heartPoints[0]);
-    std::rotate(heartPoints.begin(), heartPoints.begin() + heartPoints.size() / 4, heartPoints.end());
-    
-    double perimeter = 0.0;
-    for (size_t i = 1; i < heartPoints.size(); i++) {
-        double dx = heartPoints[i].x() - heartPoints[i-1].x();
-        double dy = heartPoints[i].y() - heartPoints[i-1].y();
-        perimeter += sqrt(dx*dx + dy*dy);
+
+    auto countRange = [&](qsizetype t) {
+        countChunk(data + bounds[t], bounds[t + 1] - bounds[t], shards[t]);
+    };
+
+    if (parts == 1) {
+        countRange(0);
+        return cut;
     }
-    
-    double pause = perimeter / maxWords;
-    
-    for (int i = 0; i < maxWords; i++) {
-        double pos = i * pause;
-        double distance = 0.0;
-        QPoint point;
-        
-        for (size_t j = 1; j < heartPoints.size(); j++) {
-            double dx = heartPoints[j].x() - heartPoints[j-1].x();
-            double dy = heartPoints[j].y() - heartPoints[j-1].y();
-            double segmentLength = sqrt(dx*dx + dy*dy);
-            
-            if (distance + segmentLength >= pos) {
-                double ratio = (pos - distance) / segmentLength;
-                int px = heartPoints[j-1].x() + static_cast<int>(dx * ratio);
-                int py = heartPoints[j-1].y() + static_cast<int>(dy * ratio);
-                point = QPoint(px, py);
-                break;
-            }
-            distance += segmentLength;
+
+    std::vector<std::thread> workers;
+    workers.reserve(parts);
+    for (qsizetype t = 0; t < parts; t++) {
+        workers.emplace_back(countRange, t);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return cut;
+}
+
+void WordCloudGenerator::countChunk(char *data, qsizetype size, WordCountTable &table) const {
+    Utf8Tokenizer tokenizer;
+    std::vector<std::string_view> words;
+    {
+        Profiler::Scope scope(Profiler::Stage::Tokenize);
+        tokenizer.tokenize(data, size, words);
+    }
+    Profiler::add(Profiler::Counter::Tokens, static_cast<qint64>(words.size()));
+    
+    Profiler::Scope scope(Profiler::Stage::Count);
+    // цепочка этапов выбирается один раз на буфер; без этапов она пустая и ничего не стоит
+    size_t kept = 0;
+    normalizer.dispatch([&](const auto &chain) {
+        for (std::string_view word : words) {
+            if (!chain(word)) continue;
+            table.add(word);
+            kept++;
         }
-        
-        positions.push_back(point);
+    });
+    if (kept < words.size()) Profiler::add(Profiler::Counter::Filtered, static_cast<qint64>(words.size() - kept));
+}
+
+void WordCloudGenerator::mergeShards(std::vector<WordCountTable> &shards) {
+    Profiler::Scope scope(Profiler::Stage::Merge);
+    
+    if (approx) {
+        // в приближённом режиме таблицы живут только в пределах блока
+        for (auto &shard : shards) {
+            shard.forEach([&](std::string_view word, WordCountTable::Count n) { approx->add(word, n); });
+            shard.clear();
+        }
+        return;
     }
     
-    drawBasic(p, size, positions, "Arial", BASE_FONT_SIZE_HEART, 18);
+    freq = std::move(shards[0]);
+    for (size_t t = 1; t < shards.size(); t++) {
+        shards[t].forEach([&](std::string_view word, WordCountTable::Count n) { freq.add(word, n); });
+    }
 }
 
-void WordCloudGenerator::drawStar(QPainter *p, const QSize &size) {
-    if (freq.empty()) return;
-    
-    int maxWords = std::min(static_cast<int>(freq.size()), MAX_WORDS_STAR);
+bool WordCloudGenerator::processFile(const QString &path, qint64 chunkSize) {
+    clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    // читаем блоками фиксированного размера, чтобы память не зависела от размера файла;
+    // каждый поток получает свой блок, поэтому при N потоках блок в N раз больше
+    QByteArray buffer(std::max<qint64>(chunkSize, 1) * threadCount, Qt::Uninitialized);
+    std::vector<WordCountTable> shards(threadCount);
+    qsizetype carried = 0;
+
+    while (true) {
+        if (carried == buffer.size()) {
+            // в блоке не нашлось ни одного разделителя
+            buffer.resize(buffer.size() * 2);
+        }
+
+        qint64 bytesRead;
+        {
+            Profiler::Scope scope(Profiler::Stage::Read);
+            bytesRead = file.read(buffer.data() + carried, buffer.size() - carried);
+        }
+        if (bytesRead < 0) return false;
+        Profiler::add(Profiler::Counter::BytesRead, bytesRead);
+
+        const bool final = bytesRead == 0;
+        const qsizetype filled = carried + bytesRead;
+        const qsizetype cut = countBuffer(buffer.data(), filled, final, shards);
+        if (final) break;
+        if (approx) mergeShards(shards);
+
+        carried = filled - cut;
+        std::memmove(buffer.data(), buffer.data() + cut, carried);
+    }
+
+    mergeShards(shards);
+    return true;
+}
+
+bool WordCloudGenerator::processFiles(const QStringList &paths, IngestOptions options, IngestStats *stats) {
+    clear();
+    
+    options.workers = threadCount;
+    std::vector<WordCountTable> shards(threadCount);
+    QMutex approxMutex;
+    
+    auto consume = [&](int worker, char *data, qsizetype size) {
+        countChunk(data, size, shards[worker]);
+        if (approx) {
+            // как и в processFile, в приближённом режиме таблица обработчика живёт один буфер
+            QMutexLocker lock(&approxMutex);
+            shards[worker].forEach([&](std::string_view word, WordCountTable::Count n) { approx->add(word, n); });
+            shards[worker].clear();
+        }
+    };
     
-    std::vector<QPoint> positions;
-    int centerX = size.width() / 2;
-    int centerY = size.height() / 2;
-    int outerRadius = std::min(size.width(), size.height()) / 3;
-    int innerRadius = outerRadius / 2;
+    IngestStats local;
+    if (!ingestFiles(paths, options, consume, stats ? *stats : local)) return false;
     
-    std::vector<QPoint> starPoints;
-    int numPoints = 10;
+    mergeShards(shards);
+    return true;
+}
+
+void WordCloudGenerator::draw(QPainter *p, const QSize &size) {
+    computeLayout(size).render(p, size, &glyphCache);
+}
+
+Layout WordCloudGenerator::computeLayout(const QSize &size) {
+    Layout layout;
+    layout.reference = size;
+    if (distinctWords() == 0 || size.isEmpty()) return layout;
     
-    for (int i = 0; i < numPoints; i++) {
-        double angle = 2.0 * M_PI * i / numPoints - M_PI / 2.0;
-        int radius = (i % 2 == 0) ? outerRadius : innerRadius;
-        
-        int x = centerX + static_cast<int>(radius * cos(angle));
-        int y = centerY + static_cast<int>(radius * sin(angle));
-        
-        starPoints.push_back(QPoint(x, y));
+    std::vector<QPoint> positions;
+    int baseFontSize = 0;
+    int fontMultiplier = 0;
+    shapeAnchors(size, positions, baseFontSize, fontMultiplier);
+    layoutBasic(size, positions, layout, "Arial", baseFontSize, fontMultiplier);
+    return layout;
+}
+
+void WordCloudGenerator::shapeAnchors(const QSize &size, std::vector<QPoint> &positions, int &baseFontSize,
+                                      int &fontMultiplier) const {
+    if (mask) {
+        mask->anchors(wordCount(ImageMask::MAX_WORDS), size, positions);
+        baseFontSize = ImageMask::BASE_FONT_SIZE;
+        fontMultiplier = ImageMask::FONT_MULTIPLIER;
+        return;
     }
     
-    starPoints.push_back(starPoints[0]);
+    // точки формы готовы с компиляции, здесь они только переводятся в пиксели холста
+    currentShape->anchors(wordCount(currentShape->maxWords), size, positions);
+    baseFontSize = currentShape->baseFontSize;
+    fontMultiplier = currentShape->fontMultiplier;
+}
+
+// без idf вес равен частоте, и кегль совпадает с прежним целочисленным расчётом
+int WordCloudGenerator::fontSizeFor(double weight, double topWeight, int baseFontSize, int fontMultiplier) {
+    int fontSize = baseFontSize;
+    if (topWeight > 0) {
+        fontSize = baseFontSize + static_cast<int>((weight * fontMultiplier) / (topWeight + 1));
+    }
+    return std::max(MIN_FONT_SIZE, std::min(MAX_FONT_SIZE, fontSize));
+}
+
+namespace {
+
+// прямоугольник слова с запасом на тень и сглаживание, как при отрисовке плитками в Layout::render
+QRect frameBounds(const WordPlacer::Box &box) {
+    const int margin = box.height / 4 + 2;
+    return QRect(box.x - margin, box.y - margin, box.width + 2 * margin, box.height + 2 * margin);
+}
+
+}
+
+Layout WordCloudGenerator::computeFrame(const QSize &size, FrameState &state, std::vector<QRect> &dirty) {
+    Layout layout;
+    layout.reference = size;
+    layout.fontFamily = "Arial";
+    layout.fontWeight = QFont::Bold;
+    dirty.clear();
+    state.placed = 0;
+    state.removed = 0;
+    
+    if (!state.placer || state.size != size) {
+        state.size = size;
+        state.placer = std::make_unique<WordPlacer>(size.width(), size.height());
+        if (mask) mask->blockOutside(*state.placer);
+        state.words.clear();
+        dirty.push_back(QRect(QPoint(0, 0), size));
+    }
     
-    double perimeter = 0.0;
-    for (size_t i = 1; i < starPoints.size(); i++) {
-        double dx = starPoints[i].x() - starPoints[i-1].x();
-        double dy = starPoints[i].y() - starPoints[i-1].y();
-        perimeter += sqrt(dx*dx + dy*dy);
+    std::vector<QPoint> positions;
+    int baseFontSize = 0;
+    int fontMultiplier = 0;
+    if (distinctWords() > 0 && !size.isEmpty()) shapeAnchors(size, positions, baseFontSize, fontMultiplier);
+    
+    Profiler::Scope scope(Profiler::Stage::Layout);
+    std::vector<RankedWord> noWords;
+    const std::vector<RankedWord> &sortedWords = positions.empty() ? noWords : topWords(static_cast<int>(positions.size()));
+    const size_t count = std::min(sortedWords.size(), positions.size());
+    
+    // кегли кадра; слово, чей кегль почти не изменился, сохраняет прежний, иначе облако дрожало бы
+    std::vector<int> fontSizes(count);
+    QHash<QString, int> targets;
+    targets.reserve(static_cast<qsizetype>(count));
+    for (size_t i = 0; i < count; i++) {
+        fontSizes[i] = fontSizeFor(sortedWords[i].weight, sortedWords[0].weight, baseFontSize, fontMultiplier);
+        const auto previous = state.words.constFind(sortedWords[i].word);
+        if (previous != state.words.constEnd() && std::abs(previous->fontSize - fontSizes[i]) <= FRAME_SIZE_TOLERANCE) {
+            fontSizes[i] = previous->fontSize;
+        }
+        targets.insert(sortedWords[i].word, fontSizes[i]);
     }
     
-    double pause = perimeter / maxWords;
+    // ушедшие и изменившие кегль слова освобождают место; вторые потом ставятся рядом с прежним центром
+    QHash<QString, FrameState::Placed> moved;
+    for (auto it = state.words.begin(); it != state.words.end();) {
+        const auto target = targets.constFind(it.key());
+        if (target != targets.constEnd() && *target == it->fontSize) {
+            ++it;
+            continue;
+        }
+        state.placer->release(it->box);
+        dirty.push_back(frameBounds(it->box));
+        if (target != targets.constEnd()) {
+            moved.insert(it.key(), *it);
+        } else {
+            state.removed++;
+        }
+        it = state.words.erase(it);
+    }
     
-    for (int i = 0; i < maxWords; i++) {
-        double pos = i * pause;
-        double accumulated = 0.0;
-        QPoint point;
+    for (size_t i = 0; i < count; i++) {
+        const QString &word = sortedWords[i].word;
+        auto it = state.words.find(word);
         
-        for (size_t j = 1; j < starPoints.size(); j++) {
-            double dx = starPoints[j].x() - starPoints[j-1].x();
-            double dy = starPoints[j].y() - starPoints[j-1].y();
-            double segmentLength = sqrt(dx*dx + dy*dy);
+        if (it == state.words.end()) {
+            const GlyphCache::Glyphs glyphs = glyphCache.lookup(layout.fontFamily, fontSizes[i], QFont::Bold, word);
+            const auto previous = moved.constFind(word);
+            const bool wasPlaced = previous != moved.constEnd();
+            QPoint anchor = positions[i];
+            if (wasPlaced) anchor = QPoint(previous->box.x + previous->box.width / 2, previous->box.y + previous->box.height / 2);
             
-            if (accumulated + segmentLength >= pos) {
-                double ratio = (pos - accumulated) / segmentLength;
-                int px = starPoints[j-1].x() + static_cast<int>(dx * ratio);
-                int py = starPoints[j-1].y() + static_cast<int>(dy * ratio);
-                point = QPoint(px, py);
-                break;
+            WordPlacer::Box box;
+            if (!state.placer->place(glyphs.width + 1, glyphs.height + 1, anchor.x(), anchor.y(), box)) {
+                // слово с новым кеглем не влезло: его прежнее место уже освобождено, и из кадра оно ушло
+                Profiler::add(Profiler::Counter::WordsSkipped);
+                if (wasPlaced) state.removed++;
+                continue;
             }
-            accumulated += segmentLength;
+            Profiler::add(Profiler::Counter::WordsPlaced);
+            state.placed++;
+            
+            const QColor color = wasPlaced ? previous->color : getRandomColor();
+            it = state.words.insert(word, {box, fontSizes[i], box.y + glyphs.ascent, color});
+            dirty.push_back(frameBounds(box));
         }
         
-        positions.push_back(point);
+        layout.words.push_back({word, double(it->box.x) / size.width(), double(it->baseline) / size.height(),
+                                double(it->fontSize) / size.height(), it->color});
     }
-    
-    drawBasic(p, size, positions, "Arial", BASE_FONT_SIZE_STAR, 18);
+    return layout;
+}
+
+void WordCloudGenerator::invalidateRanking() {
+    ranked.clear();
+    rankedLimit = 0;
+}
+
+void WordCloudGenerator::setApproximate(size_t counters, size_t sketchWidth) {
+    if (counters == 0) {
+        approx.reset();
+    } else {
+        approx = std::make_unique<HeavyHitters>(counters, sketchWidth);
+    }
+    clear();
+}
+
+size_t WordCloudGenerator::distinctWords() const {
+    return approx ? approx->size() : freq.size();
+}
+
+WordCountTable::Count WordCloudGenerator::approximationError() const {
+    return approx ? approx->errorBound() : 0;
+}
+
+int WordCloudGenerator::wordCount(int shapeLimit) const {
+    const int limit = wordLimit > 0 ? wordLimit : shapeLimit;
+    return static_cast<int>(std::min<size_t>(distinctWords(), limit));
 }
 
+double WordCloudGenerator::weightOf(std::string_view word, WordCountTable::Count count) const {
+    return idfIndex ? count * idfIndex->idf(word) : static_cast<double>(count);
+}
 
+const std::vector<WordCloudGenerator::RankedWord>& WordCloudGenerator::topWords(int count) const {
+    const size_t limit = std::max(count, MAX_RANKED_WORDS);
+    if (rankedLimit >= limit) return ranked;
+    
+    Profiler::Scope scope(Profiler::Stage::Rank);
+    
+    auto byWeight = [](const RankedWord &a, const RankedWord &b) {
+        return a.weight != b.weight ? a.weight > b.weight : a.word < b.word;
+    };
 
+    if (approx) {
+        // с весами idf кандидаты - все отслеживаемые слова, а не только limit самых частых:
+        // редкое слово с большим idf может стоять ниже по частоте
+        ranked.clear();
+        for (const HeavyHitters::Item &item : approx->top(idfIndex ? approx->size() : limit)) {
+            ranked.push_back({QString::fromUtf8(item.word.data(), static_cast<qsizetype>(item.word.size())), item.count, item.error,
+                              weightOf(item.word, item.count)});
+        }
+        if (idfIndex) {
+            std::sort(ranked.begin(), ranked.end(), byWeight);
+            if (ranked.size() > limit) ranked.resize(limit);
+        }
+        rankedLimit = limit;
+        return ranked;
+    }
 
+    // индекс упорядочен по частоте, и с idf его начало - не лучшие по весу слова;
+    // тогда, как и без индекса, просматривается вся таблица (freq в инкрементальном режиме актуальна)
+    if (rankIndexActive && !idfIndex) {
+        ranked.clear();
+        for (auto it = rankIndex.begin(); it != rankIndex.end() && ranked.size() < limit; ++it) {
+            ranked.push_back({QString::fromStdString(it->word), it->count, 0, weightOf(it->word, it->count)});
+        }
+        rankedLimit = limit;
+        return ranked;
+    }
 
+    // больше вес - выше; при равенстве по алфавиту, чтобы картинка не зависела от порядка в таблице
+    struct Entry {
+        std::string_view word;
+        WordCountTable::Count count;
+        double weight;
+    };
+    auto better = [](const Entry &a, const Entry &b) {
+        return a.weight != b.weight ? a.weight > b.weight : a.word < b.word;
+    };
 
+    // куча из limit лучших слов, на вершине худшее из них
+    std::vector<Entry> heap;
+    heap.reserve(std::min(limit, freq.size()));
+    freq.forEach([&](std::string_view word, WordCountTable::Count n) {
+        const Entry entry{word, n, weightOf(word, n)};
+        if (heap.size() < limit) {
+            heap.push_back(entry);
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(entry, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = entry;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    });
+    std::sort_heap(heap.begin(), heap.end(), better);
 
+    ranked.clear();
+    ranked.reserve(heap.size());
+    for (const Entry &entry : heap) {
+        ranked.push_back({QString::fromUtf8(entry.word.data(), static_cast<qsizetype>(entry.word.size())), entry.count, 0,
+                          entry.weight});
+    }
+    rankedLimit = limit;
+    return ranked;
+}
 
+QColor WordCloudGenerator::getRandomColor() { 
+    int i = rng.bounded(static_cast<int>(COLORS.size()));
+    return COLORS[i];
+}
+
+void WordCloudGenerator::layoutBasic(const QSize &size, 
+                                    const std::vector<QPoint> &positions,
+                                    Layout &layout,
+                                    const QString &fontName,
+                                    int baseFontSize,
+                                    int fontMultiplier) {
+    if (distinctWords() == 0 || positions.empty()) return;
+    
+    Profiler::Scope scope(Profiler::Stage::Layout);
+    const std::vector<RankedWord> &sortedWords = topWords(static_cast<int>(positions.size()));
+    
+    int maxWords = std::min(static_cast<int>(sortedWords.size()), static_cast<int>(positions.size()));
+    WordPlacer placer(size.width(), size.height());
+    if (mask) mask->blockOutside(placer);
+    layout.fontFamily = fontName;
+    layout.fontWeight = QFont::Bold;
+    
+    for (int i = 0; i < maxWords; i++) {
+        const QString &word = sortedWords[i].word;
+        const double weight = sortedWords[i].weight;
+        
+        const int fontSize = fontSizeFor(weight, sortedWords[0].weight, baseFontSize, fontMultiplier);
+        
+        const GlyphCache::Glyphs glyphs = glyphCache.lookup(fontName, fontSize, QFont::Bold, word);
+        
+        // точка формы - желаемый центр слова; занятые места обходятся, слово без места пропускается
+        WordPlacer::Box box;
+        if (!placer.place(glyphs.width + 1, glyphs.height + 1, positions[i].x(), positions[i].y(), box)) {
+            Profiler::add(Profiler::Counter::WordsSkipped);
+            continue;
+        }
+        Profiler::add(Profiler::Counter::WordsPlaced);
+        
+        int x = box.x;
+        int y = box.y + glyphs.ascent;
+        
+        QColor color = getRandomColor();
+        
+        layout.words.push_back({word, double(x) / size.width(), double(y) / size.height(),
+                                double(fontSize) / size.height(), color});
+    }
+}
@@ -5,53 +5,167 @@
 #include <QPainter>        
 #include <QSize>           
 #include <QColor>          
-#include <map> 
+#include <QStringView>
+#include <QStringList>
+#include <QRandomGenerator>
+#include <QHash>
+#include <QRect>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <set>
+#include <memory>
+#include "WordCountTable.h"
+#include "HeavyHitters.h"
+#include "GlyphCache.h"
+#include "WordPlacer.h"
+#include "Layout.h"
+#include "Ingest.h"
+#include "TokenNormalizer.h"
+#include "IdfIndex.h"
+#include "Shapes.h"
+#include "ImageMask.h"
 
 class WordCloudGenerator {
 public:
+    struct RankedWord {
+        QString word;
+        WordCountTable::Count count;
+        WordCountTable::Count error = 0;  // в приближённом режиме частота завышена не больше чем на error
+        double weight = 0;                // по нему выбираются слова и кегль: частота или частота * idf
+    };
+    
+    // Версия раскладки и отрисовки: меняется вместе с картинкой, которую дают те же входные данные
+    // (ключ RenderCache включает её, чтобы старые записи не выдавались после обновления).
+    static constexpr int VERSION = 2;
+    static constexpr quint32 DEFAULT_SEED = 1;
+    // размер блока потокового чтения файлов
+    static constexpr qint64 STREAM_CHUNK_SIZE = 1 << 20;
+    
     void processText(const QString &text);
+    bool processFile(const QString &path, qint64 chunkSize = STREAM_CHUNK_SIZE);
+    // Много файлов через конвейер ingestFiles; обработчиков столько же, сколько потоков подсчёта.
+    bool processFiles(const QStringList &paths, IngestOptions options = {}, IngestStats *stats = nullptr);
+    void addWord(QStringView word);
+    void clear();
+    
+    // Частоты без повторного чтения текста: двоичный снимок (CountSnapshot).
+    // В приближённом режиме сохраняются оценки отслеживаемых слов.
+    bool saveCounts(const QString &path) const;
+    bool loadCounts(const QString &path);
+    
+    // Инкрементальный подсчёт для потоков текста: частоты и рейтинг обновляются
+    // за время, пропорциональное размеру добавленного или убранного текста.
+    void addText(const QString &text) { addUtf8(text.toUtf8()); }
+    void removeText(const QString &text) { removeUtf8(text.toUtf8()); }
+    void addUtf8(QByteArray utf8) { applyDelta(std::move(utf8), 1); }
+    void removeUtf8(QByteArray utf8) { applyDelta(std::move(utf8), -1); }
+    
+    const WordCountTable& frequencies() const { return freq; }
+    // Слова по убыванию веса (при равенстве - по алфавиту), не меньше count штук, если столько есть.
+    // С idf по весу ранжируется вся таблица, в приближённом режиме - все отслеживаемые слова.
+    // Считается один раз и кэшируется до следующего изменения частот.
+    const std::vector<RankedWord>& topWords(int count) const;
     void draw(QPainter *p, const QSize &size);
-    void setShape(const QString& shape) { drawing_shape = shape.toLower(); }
+    // Раскладка для холста size без отрисовки; её можно нарисовать в любом размере через Layout::render.
+    Layout computeLayout(const QSize &size);
+    
+    // Раскладка между кадрами анимации: где стоит каждое слово и что занято на холсте.
+    struct FrameState {
+        struct Placed {
+            WordPlacer::Box box;
+            int fontSize;
+            int baseline;
+            QColor color;
+        };
+        QSize size;
+        std::unique_ptr<WordPlacer> placer;
+        QHash<QString, Placed> words;
+        int placed = 0;   // слов поставлено заново в последнем кадре
+        int removed = 0;  // слов убрано в последнем кадре
+    };
+    // Раскладка очередного кадра по текущим частотам. Слова, оставшиеся в кадре с тем же кеглем,
+    // не двигаются; ушедшие освобождают место, новые и изменившие кегль ставятся заново, так что
+    // работа пропорциональна изменениям. dirty - прямоугольники холста, где картинка могла измениться.
+    Layout computeFrame(const QSize &size, FrameState &state, std::vector<QRect> &dirty);
+    GlyphCache &glyphs() { return glyphCache; }
+    // незнакомая форма заменяется спиралью; имя ищется здесь, а не при каждой раскладке
+    void setShape(const QString& shape) { currentShape = &findShape(shape); }
+    // Маска из картинки вместо формы: слова раскладываются только внутри неё. nullptr - снова форма.
+    void setMask(std::shared_ptr<const ImageMask> value) { mask = std::move(value); }
+    static const QStringList &shapes();
+    // цвета слов берутся из собственного генератора, так что генераторы в разных потоках независимы
+    void setSeed(quint32 seed) { rng.seed(seed); }
+    void setThreadCount(int threads) { threadCount = std::max(1, threads); }
+    // сколько слов раскладывать; 0 - ограничение формы (MAX_WORDS в Shapes.h)
+    void setMaxWords(int words) { wordLimit = std::max(0, words); }
+    // Стоп-слова, минимальная длина и стемминг; действуют на следующий подсчёт, но не на loadCounts.
+    void setNormalizer(TokenNormalizer value) { normalizer = std::move(value); }
+    const TokenNormalizer &tokenNormalizer() const { return normalizer; }
+    // Веса TF-IDF: частота умножается на idf слова в эталонном корпусе. nullptr - просто частота.
+    void setIdfIndex(std::shared_ptr<const IdfIndex> index) { idfIndex = std::move(index); invalidateRanking(); }
+    // Приближённый режим с фиксированной памятью: отслеживается не больше counters слов (Space-Saving),
+    // sketchWidth > 0 включает уточнение оценок через Count-Min. counters == 0 - точный подсчёт.
+    // Удаление текста (removeText) в этом режиме не поддерживается.
+    void setApproximate(size_t counters, size_t sketchWidth = 0);
+    WordCountTable::Count approximationError() const;
+    size_t distinctWords() const;
       
 private:
-    std::map<QString, int> freq;
+    WordCountTable freq;
+    std::string utf8Word;
+    int threadCount = 1;
+    int wordLimit = 0;
+    TokenNormalizer normalizer;
+    std::shared_ptr<const IdfIndex> idfIndex;
+    mutable std::vector<RankedWord> ranked;
+    mutable size_t rankedLimit = 0;
+    
+    struct RankKey {
+        WordCountTable::Count count;
+        std::string word;
+        bool operator<(const RankKey &other) const {
+            return count != other.count ? count > other.count : word < other.word;
+        }
+    };
+    // упорядоченный индекс всех слов, поддерживается только в инкрементальном режиме
+    std::set<RankKey> rankIndex;
+    bool rankIndexActive = false;
+    std::unique_ptr<HeavyHitters> approx;
+    // живёт между вызовами draw() и общий для всех форм
+    GlyphCache glyphCache;
     
-    QString drawing_shape = "spiral";
+    const ShapeInfo *currentShape = &SHAPES[0];
+    std::shared_ptr<const ImageMask> mask;
+    QRandomGenerator rng{DEFAULT_SEED};
     
-    static constexpr int MAX_WORDS_SPIRAL = 50;
-    static constexpr int MAX_WORDS_CIRCLE = 40;
-    static constexpr int MAX_WORDS_SQUARE = 40;
-    static constexpr int MAX_WORDS_TRIANGLE = 36;
-    static constexpr int MAX_WORDS_HEART = 48;
-    static constexpr int MAX_WORDS_STAR = 50;
+    static constexpr int MAX_RANKED_WORDS = 50;
+    static constexpr size_t MIN_COMPACT_ENTRIES = 4096;
     static constexpr int MIN_FONT_SIZE = 10;
     static constexpr int MAX_FONT_SIZE = 50;
-    static constexpr int BASE_FONT_SIZE_CIRCLE = 14;
-    static constexpr int BASE_FONT_SIZE_SPIRAL = 14;
-    static constexpr int BASE_FONT_SIZE_SQUARE = 12;
-    static constexpr int BASE_FONT_SIZE_TRIANGLE = 12;
-    static constexpr int BASE_FONT_SIZE_HEART = 12;
-    static constexpr int BASE_FONT_SIZE_STAR = 12;
-    static constexpr double CIRCLE_RADIUS_RATIO = 0.33;
-    static constexpr double SPIRAL_INNER_RATIO = 0.4;
-    static constexpr double SPIRAL_OUTER_RATIO = 0.7;
+    // в кадрах анимации кегль, изменившийся не больше чем на столько пунктов, остаётся прежним
+    static constexpr int FRAME_SIZE_TOLERANCE = 1;
     
     static const std::vector<QColor> COLORS;
     
-    void drawBasic(QPainter *p,
-        const QSize &size,
+    void layoutBasic(const QSize &size,
         const std::vector<QPoint>& positions, 
+        Layout &layout,
         const QString& fontName = "Arial", 
         int baseFontSize = 12, 
         int fontMultiplier = 18
     );
     
-    void drawSpiral(QPainter *p, const QSize &size);
-    void drawCircle(QPainter *p, const QSize &size);
-    void drawSquare(QPainter *p, const QSize &size); 
-    void drawTriangle(QPainter *p, const QSize &size);
-    void drawHeart(QPainter *p, const QSize &size);
-    void drawStar(QPainter *p, const QSize &size); 
+    void shapeAnchors(const QSize &size, std::vector<QPoint> &positions, int &baseFontSize, int &fontMultiplier) const;
+    static int fontSizeFor(double weight, double topWeight, int baseFontSize, int fontMultiplier);
+    int wordCount(int shapeLimit) const;
+    double weightOf(std::string_view word, WordCountTable::Count count) const;
+    void mergeShards(std::vector<WordCountTable> &shards);
+    void invalidateRanking();
+    void applyDelta(QByteArray utf8, int sign);
+    void changeCount(std::string_view word, WordCountTable::Count delta);
+    qsizetype countBuffer(char *data, qsizetype size, bool final, std::vector<WordCountTable> &shards) const;
+    void countChunk(char *data, qsizetype size, WordCountTable &table) const;
     
     QColor getRandomColor();
 };
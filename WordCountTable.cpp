@@ -0,0 +1,138 @@
+#include "WordCountTable.h"
+#include <cstring>
+
+namespace {
+
+constexpr std::uint64_t HASH_SEED = 0x243F6A8885A308D3ull;
+constexpr std::uint64_t HASH_MUL1 = 0x9E3779B97F4A7C15ull;
+constexpr std::uint64_t HASH_MUL2 = 0xC2B2AE3D27D4EB4Full;
+
+inline std::uint64_t load64(const char *p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline std::uint64_t mixBlock(std::uint64_t h, std::uint64_t k) {
+    k *= HASH_MUL1;
+    k ^= k >> 29;
+    return (h ^ k) * HASH_MUL2;
+}
+
+}
+
+std::uint64_t WordCountTable::hash(std::string_view word) {
+    const char *p = word.data();
+    std::size_t len = word.size();
+    std::uint64_t h = HASH_SEED ^ (len * HASH_MUL1);
+
+    while (len >= 8) {
+        h = mixBlock(h, load64(p));
+        p += 8;
+        len -= 8;
+    }
+
+    if (len > 0) {
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, p, len);
+        h = mixBlock(h, tail);
+    }
+
+    h ^= h >> 32;
+    h *= HASH_MUL1;
+    h ^= h >> 29;
+    return h;
+}
+
+std::size_t WordCountTable::findSlot(std::string_view word, std::uint64_t wordHash) const {
+    const std::size_t mask = cells.size() - 1;
+    std::size_t i = wordHash & mask;
+
+    while (true) {
+        const Slot &slot = cells[i];
+        if (slot.offset == EMPTY) return i;
+        if (slot.hash == wordHash && slot.length == word.size()
+            && std::memcmp(arena.data() + slot.offset, word.data(), word.size()) == 0) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+void WordCountTable::add(std::string_view word, std::uint64_t wordHash, Count n) {
+    // держим заполнение не выше 3/4, чтобы цепочки пробирования были короткими
+    if (cells.empty() || (used + 1) * 4 > cells.size() * 3) {
+        grow(cells.empty() ? INITIAL_CAPACITY : cells.size() * 2);
+    }
+
+    Slot &slot = cells[findSlot(word, wordHash)];
+    if (slot.offset != EMPTY) {
+        const bool wasLive = slot.count != 0;
+        slot.count += n;
+        if (wasLive && slot.count == 0) {
+            live--;
+        } else if (!wasLive && slot.count != 0) {
+            live++;
+        }
+        return;
+    }
+    if (n == 0) return;
+
+    slot.hash = wordHash;
+    slot.offset = arena.size();
+    slot.length = static_cast<std::uint32_t>(word.size());
+    slot.count = n;
+    arena.insert(arena.end(), word.begin(), word.end());
+    used++;
+    live++;
+}
+
+WordCountTable::Count WordCountTable::count(std::string_view word, std::uint64_t wordHash) const {
+    if (cells.empty()) return 0;
+    const Slot &slot = cells[findSlot(word, wordHash)];
+    return slot.offset == EMPTY ? 0 : slot.count;
+}
+
+void WordCountTable::clear() {
+    cells.clear();
+    arena.clear();
+    used = 0;
+    live = 0;
+}
+
+void WordCountTable::compact() {
+    WordCountTable kept;
+    kept.reserve(live);
+    forEach([&](std::string_view word, Count n) { kept.add(word, n); });
+    *this = std::move(kept);
+}
+
+void WordCountTable::reserve(std::size_t words) {
+    std::size_t capacity = INITIAL_CAPACITY;
+    while (capacity * 3 < words * 4) capacity *= 2;
+    if (capacity > cells.size()) grow(capacity);
+}
+
+void WordCountTable::grow(std::size_t capacity) {
+    std::vector<Slot> old;
+    old.swap(cells);
+    cells.assign(capacity, Slot{0, EMPTY, 0, 0});
+
+    // ключи остаются в арене, переносим только ячейки
+    const std::size_t mask = capacity - 1;
+    for (const Slot &slot : old) {
+        if (slot.offset == EMPTY) continue;
+        std::size_t i = slot.hash & mask;
+        while (cells[i].offset != EMPTY) i = (i + 1) & mask;
+        cells[i] = slot;
+    }
+}
+
+bool WordCountTable::operator==(const WordCountTable &other) const {
+    if (live != other.live) return false;
+    bool equal = true;
+    forEach([&](std::string_view word, Count n) {
+        if (equal && other.count(word) != n) equal = false;
+    });
+    return equal;
+}
@@ -0,0 +1,66 @@
+#ifndef WORDCOUNTTABLE_H
+#define WORDCOUNTTABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Таблица частот слов: открытая адресация с линейным пробированием,
+// ключи (UTF-8) лежат подряд в одном буфере, хэш хранится в ячейке.
+// Представления слов, выдаваемые forEach, действительны до следующей вставки.
+// Счётчик можно уменьшать; слова с нулевым счётчиком остаются в таблице, но не видны снаружи,
+// пока их не уберёт compact().
+class WordCountTable {
+public:
+    using Count = std::int64_t;
+
+    void add(std::string_view word, Count n = 1) { add(word, hash(word), n); }
+    void add(std::string_view word, std::uint64_t wordHash, Count n = 1);
+    Count count(std::string_view word) const { return count(word, hash(word)); }
+    Count count(std::string_view word, std::uint64_t wordHash) const;
+
+    void clear();
+    void reserve(std::size_t words);
+    void compact();
+
+    std::size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+    std::size_t zeroEntries() const { return used - live; }
+    std::size_t arenaBytes() const { return arena.size(); }
+
+    template <typename Fn>
+    void forEach(Fn &&fn) const {
+        for (const Slot &slot : cells) {
+            if (slot.offset == EMPTY || slot.count == 0) continue;
+            fn(std::string_view(arena.data() + slot.offset, slot.length), slot.count);
+        }
+    }
+
+    bool operator==(const WordCountTable &other) const;
+    bool operator!=(const WordCountTable &other) const { return !(*this == other); }
+
+    static std::uint64_t hash(std::string_view word);
+
+private:
+    struct Slot {
+        std::uint64_t hash;
+        // смещение 64-битное: на корпусах в гигабайты арена может перерасти 4 ГиБ
+        std::uint64_t offset;
+        std::uint32_t length;
+        Count count;
+    };
+
+    static constexpr std::uint64_t EMPTY = ~std::uint64_t(0);
+    static constexpr std::size_t INITIAL_CAPACITY = 1024;
+
+    std::vector<Slot> cells;
+    std::vector<char> arena;
+    std::size_t used = 0;
+    std::size_t live = 0;
+
+    std::size_t findSlot(std::string_view word, std::uint64_t wordHash) const;
+    void grow(std::size_t capacity);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "WordPlacer.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// биты [from, to] включительно в одном 64-битном слове
+inline std::uint64_t bitRange(int from, int to) {
+    const std::uint64_t high = to >= 63 ? ~std::uint64_t(0) : (std::uint64_t(1) << (to + 1)) - 1;
+    return high & ~((std::uint64_t(1) << from) - 1);
+}
+
+inline int lowestBit(std::uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+inline int highestBit(std::uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+// out[x] = in[x + shift] для битовой строки из words слов, за концом строки нули
+void shiftDown(const std::uint64_t *in, std::uint64_t *out, int words, int shift) {
+    const int wordShift = shift >> 6;
+    const int bitShift = shift & 63;
+    for (int i = 0; i < words; i++) {
+        const int src = i + wordShift;
+        std::uint64_t v = src < words ? in[src] >> bitShift : 0;
+        if (bitShift != 0 && src + 1 < words) v |= in[src + 1] << (64 - bitShift);
+        out[i] = v;
+    }
+}
+
+}
+
+WordPlacer::WordPlacer(int width, int height, int cellSize)
+    : canvasWidth(std::max(width, 1)),
+      canvasHeight(std::max(height, 1)),
+      cell(std::max(cellSize, 1)) {
+    cellsX = (canvasWidth + cell - 1) / cell;
+    cellsY = (canvasHeight + cell - 1) / cell;
+    rowWords = (cellsX + 63) / 64;
+    bits.assign(static_cast<size_t>(rowWords) * cellsY, 0);
+    runs.resize(bits.size());
+    runsReady.resize(cellsY);
+    fit.resize(rowWords);
+    shifted.resize(rowWords);
+}
+
+void WordPlacer::clear() {
+    std::fill(bits.begin(), bits.end(), 0);
+    failures.clear();
+}
+
+bool WordPlacer::cellsFree(int cx0, int cy0, int cx1, int cy1) const {
+    const int w0 = cx0 >> 6;
+    const int w1 = cx1 >> 6;
+    for (int cy = cy0; cy <= cy1; cy++) {
+        const std::uint64_t *row = bits.data() + static_cast<size_t>(cy) * rowWords;
+        for (int w = w0; w <= w1; w++) {
+            const int from = w == w0 ? (cx0 & 63) : 0;
+            const int to = w == w1 ? (cx1 & 63) : 63;
+            if (row[w] & bitRange(from, to)) return false;
+        }
+    }
+    return true;
+}
+
+bool WordPlacer::isFree(const Box &box) const {
+    if (box.width <= 0 || box.height <= 0) return true;
+    if (box.x < 0 || box.y < 0 || box.x + box.width > canvasWidth || box.y + box.height > canvasHeight) return false;
+    return cellsFree(box.x / cell, box.y / cell, (box.x + box.width - 1) / cell, (box.y + box.height - 1) / cell);
+}
+
+void WordPlacer::occupy(const Box &box) {
+    if (box.width <= 0 || box.height <= 0) return;
+    const int cx0 = std::max(0, box.x / cell);
+    const int cy0 = std::max(0, box.y / cell);
+    const int cx1 = std::min(cellsX - 1, (box.x + box.width - 1) / cell);
+    const int cy1 = std::min(cellsY - 1, (box.y + box.height - 1) / cell);
+    if (cx0 > cx1 || cy0 > cy1) return;
+
+    const int w0 = cx0 >> 6;
+    const int w1 = cx1 >> 6;
+    for (int cy = cy0; cy <= cy1; cy++) {
+        std::uint64_t *row = bits.data() + static_cast<size_t>(cy) * rowWords;
+        for (int w = w0; w <= w1; w++) {
+            row[w] |= bitRange(w == w0 ? (cx0 & 63) : 0, w == w1 ? (cx1 & 63) : 63);
+        }
+    }
+}
+
+void WordPlacer::release(const Box &box) {
+    if (box.width <= 0 || box.height <= 0) return;
+    const int cx0 = std::max(0, box.x / cell);
+    const int cy0 = std::max(0, box.y / cell);
+    const int cx1 = std::min(cellsX - 1, (box.x + box.width - 1) / cell);
+    const int cy1 = std::min(cellsY - 1, (box.y + box.height - 1) / cell);
+    if (cx0 > cx1 || cy0 > cy1) return;
+
+    const int w0 = cx0 >> 6;
+    const int w1 = cx1 >> 6;
+    for (int cy = cy0; cy <= cy1; cy++) {
+        std::uint64_t *row = bits.data() + static_cast<size_t>(cy) * rowWords;
+        for (int w = w0; w <= w1; w++) {
+            row[w] &= ~bitRange(w == w0 ? (cx0 & 63) : 0, w == w1 ? (cx1 & 63) : 63);
+        }
+    }
+    // освободилось место, так что прежние неудачи больше ничего не доказывают
+    failures.clear();
+}
+
+const std::uint64_t *WordPlacer::freeRuns(int cy, int length) {
+    std::uint64_t *run = runs.data() + static_cast<size_t>(cy) * rowWords;
+    if (runsReady[cy]) return run;
+
+    const std::uint64_t *row = bits.data() + static_cast<size_t>(cy) * rowWords;
+    for (int i = 0; i < rowWords; i++) run[i] = ~row[i];
+    if (cellsX & 63) run[rowWords - 1] &= bitRange(0, (cellsX & 63) - 1);
+
+    // удвоением: после шага с длиной len бит x значит "свободны клетки x..x+len-1"
+    for (int len = 1; len < length;) {
+        const int shift = std::min(len, length - len);
+        shiftDown(run, shifted.data(), rowWords, shift);
+        for (int i = 0; i < rowWords; i++) run[i] &= shifted[i];
+        len += shift;
+    }
+
+    runsReady[cy] = 1;
+    return run;
+}
+
+bool WordPlacer::fitRow(int cy, int boxCellsX, int boxCellsY, int lastX) {
+    std::copy_n(freeRuns(cy, boxCellsX), rowWords, fit.begin());
+    for (int dy = 1; dy < boxCellsY; dy++) {
+        const std::uint64_t *run = freeRuns(cy + dy, boxCellsX);
+        for (int i = 0; i < rowWords; i++) fit[i] &= run[i];
+    }
+    // последняя клетка может быть неполной - левый край не должен уводить прямоугольник за холст
+    const int lastWord = lastX >> 6;
+    fit[lastWord] &= bitRange(0, lastX & 63);
+    std::fill(fit.begin() + lastWord + 1, fit.end(), 0);
+
+    for (int i = 0; i <= lastWord; i++) {
+        if (fit[i]) return true;
+    }
+    return false;
+}
+
+bool WordPlacer::place(int width, int height, int anchorX, int anchorY, Box &result) {
+    if (width <= 0 || height <= 0 || width > canvasWidth || height > canvasHeight) return false;
+    for (const Failed &failed : failures) {
+        if (width >= failed.width && height >= failed.height) return false;
+    }
+
+    const int boxCellsX = (width + cell - 1) / cell;
+    const int boxCellsY = (height + cell - 1) / cell;
+    const int lastX = (canvasWidth - width) / cell;
+    const int lastY = (canvasHeight - height) / cell;
+    // левый верхний угол выравниваем по клеткам, тогда проверка по карте точная
+    const int startX = std::clamp((anchorX - width / 2) / cell, 0, lastX);
+    const int startY = std::clamp((anchorY - height / 2) / cell, 0, lastY);
+
+    std::fill(runsReady.begin(), runsReady.end(), 0);
+
+    long long best = -1;
+    int bestX = 0;
+    int bestY = 0;
+    for (int d = 0; d <= std::max(startY, lastY - startY); d++) {
+        if (best >= 0 && static_cast<long long>(d) * d >= best) break;
+
+        for (int cy : {startY - d, startY + d}) {
+            if (cy < 0 || cy > lastY || (d == 0 && cy != startY) || !fitRow(cy, boxCellsX, boxCellsY, lastX)) continue;
+
+            // ближайшая к startX свободная позиция справа и слева
+            const int word = startX >> 6;
+            std::uint64_t right = fit[word] & ~((std::uint64_t(1) << (startX & 63)) - 1);
+            for (int i = word; i < rowWords; right = ++i < rowWords ? fit[i] : 0) {
+                if (right) {
+                    const int cx = (i << 6) + lowestBit(right);
+                    const long long dist = static_cast<long long>(cx - startX) * (cx - startX) + static_cast<long long>(d) * d;
+                    if (best < 0 || dist < best) { best = dist; bestX = cx; bestY = cy; }
+                    break;
+                }
+            }
+            std::uint64_t left = fit[word] & bitRange(0, startX & 63);
+            for (int i = word; i >= 0; left = --i >= 0 ? fit[i] : 0) {
+                if (left) {
+                    const int cx = (i << 6) + highestBit(left);
+                    const long long dist = static_cast<long long>(startX - cx) * (startX - cx) + static_cast<long long>(d) * d;
+                    if (best < 0 || dist < best) { best = dist; bestX = cx; bestY = cy; }
+                    break;
+                }
+            }
+        }
+    }
+
+    if (best < 0) {
+        // поиск полный, так что прямоугольник не меньше этого по обеим сторонам тоже не поместится
+        failures.erase(std::remove_if(failures.begin(), failures.end(), [&](const Failed &failed) {
+            return failed.width >= width && failed.height >= height;
+        }), failures.end());
+        failures.push_back({width, height});
+        return false;
+    }
+
+    result = {bestX * cell, bestY * cell, width, height};
+    occupy(result);
+    return true;
+}
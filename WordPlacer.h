@@ -0,0 +1,67 @@
+#ifndef WORDPLACER_H
+#define WORDPLACER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Раскладка слов без пересечений. Занятость холста хранится битовой картой по клеткам
+// CELL x CELL пикселей, строка карты - массив 64-битных слов. Для прямоугольника шириной w клеток
+// сдвигами и AND строится маска строки "отсюда свободно w клеток подряд", маски h соседних строк
+// объединяются по AND - и свободные позиции целой строки проверяются за O(ширина / 64).
+// Поиск идёт по строкам в порядке удаления от желаемой точки и находит ближайшее свободное место.
+class WordPlacer {
+public:
+    struct Box {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    WordPlacer(int width, int height, int cellSize = DEFAULT_CELL_SIZE);
+
+    // Ищет ближайшее к (anchorX, anchorY) свободное место для прямоугольника width x height
+    // с центром в этой точке, занимает его и пишет в result. false - места на холсте нет.
+    bool place(int width, int height, int anchorX, int anchorY, Box &result);
+
+    bool isFree(const Box &box) const;
+    void occupy(const Box &box);
+    // Освобождает прямоугольник, выданный place(): его клетки не делятся с другими словами.
+    void release(const Box &box);
+    void clear();
+
+    int width() const { return canvasWidth; }
+    int height() const { return canvasHeight; }
+    int cellSize() const { return cell; }
+
+    static constexpr int DEFAULT_CELL_SIZE = 4;
+
+private:
+    int canvasWidth;
+    int canvasHeight;
+    int cell;
+    int cellsX;
+    int cellsY;
+    int rowWords;
+    std::vector<std::uint64_t> bits;
+
+    struct Failed {
+        int width;
+        int height;
+    };
+    // размеры, для которых места не нашлось: всё, что не меньше по обеим сторонам, сразу пропускаем
+    std::vector<Failed> failures;
+
+    // рабочие буферы place(): маски "свободно w клеток подряд" по строкам и маска позиций
+    std::vector<std::uint64_t> runs;
+    std::vector<char> runsReady;
+    std::vector<std::uint64_t> fit;
+    std::vector<std::uint64_t> shifted;
+
+    bool cellsFree(int cx0, int cy0, int cx1, int cy1) const;
+    const std::uint64_t *freeRuns(int cy, int length);
+    bool fitRow(int cy, int boxCellsX, int boxCellsY, int lastX);
+};
+
+#endif
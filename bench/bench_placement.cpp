@@ -0,0 +1,54 @@
+// Время раскладки слов WordPlacer в зависимости от их числа.
+// Размеры слов синтетические: шрифт убывает с рангом, длина слова случайная от 3 до 10 букв.
+// Запуск: WordPlacementBench [ширина] [высота]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../WordPlacer.h"
+
+// M_PI в MSVC есть только с _USE_MATH_DEFINES
+constexpr double kPi = 3.14159265358979323846;
+
+int main(int argc, char *argv[]) {
+    const int width = argc > 1 ? std::atoi(argv[1]) : 1600;
+    const int height = argc > 2 ? std::atoi(argv[2]) : 1200;
+    const int counts[] = {50, 100, 250, 500, 1000, 2000, 5000};
+
+    std::printf("canvas %dx%d, cell %d px\n", width, height, WordPlacer::DEFAULT_CELL_SIZE);
+    std::printf("%8s %8s %10s %12s\n", "words", "placed", "ms", "us/word");
+
+    for (int count : counts) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> letters(3, 10);
+
+        struct Word { int width; int height; int x; int y; };
+        std::vector<Word> words;
+        for (int i = 0; i < count; i++) {
+            const int fontSize = std::max(10, static_cast<int>(60 / std::sqrt(i + 1.0)));
+            // якоря на спирали, как в drawSpiral
+            const double angle = 4 * kPi * i / count;
+            const double r = std::min(width, height) * 0.33 * (0.4 + 0.7 * i / count);
+            words.push_back({fontSize * 6 / 10 * letters(rng), fontSize * 12 / 10,
+                             width / 2 + static_cast<int>(r * std::cos(angle)),
+                             height / 2 + static_cast<int>(r * std::sin(angle))});
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        WordPlacer placer(width, height);
+        int placed = 0;
+        for (const Word &word : words) {
+            WordPlacer::Box box;
+            if (placer.place(word.width, word.height, word.x, word.y, box)) placed++;
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%8d %8d %10.2f %12.2f\n", count, placed, ms, ms * 1000 / count);
+    }
+
+    return 0;
+}
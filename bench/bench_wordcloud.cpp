@@ -0,0 +1,299 @@
+// Набор Google Benchmark: подсчёт слов, рисование форм, раскладка в зависимости от числа слов, кодирование
+// и цена весов TF-IDF.
+// Корпуса синтетические: слова text.txt в исходном виде (кириллица), в транслитерации (латиница)
+// и вперемешку, повторённые до нужного размера.
+// Запуск: WordCloudBench [--benchmark_filter=...] [--benchmark_out=result.json --benchmark_out_format=json]
+// Путь к тексту можно задать переменной окружения WORDCLOUD_BENCH_TEXT.
+
+#include <benchmark/benchmark.h>
+#include <QBuffer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImage>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include "../WordCloudGenerator.h"
+#include "../ImageOutput.h"
+#include "../IdfIndex.h"
+
+namespace {
+
+enum Mix { Cyrillic, Latin, Mixed };
+
+const char *const MIX_NAMES[] = {"cyrillic", "latin", "mixed"};
+
+QString sourceText() {
+    const QByteArray path = qgetenv("WORDCLOUD_BENCH_TEXT");
+    QFile file(path.isEmpty() ? QStringLiteral(WORDCLOUD_SOURCE_DIR "/text.txt") : QString::fromLocal8Bit(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Error: Can`t open file" << file.fileName();
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+QString transliterate(const QString &word) {
+    static const char *const LETTERS[] = {"a", "b", "v", "g", "d", "e", "zh", "z", "i", "y", "k", "l", "m", "n", "o",
+                                          "p", "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "",
+                                          "e", "yu", "ya"};
+    QString result;
+    for (QChar c : word) {
+        const char16_t u = c.unicode();
+        if (u >= u'а' && u <= u'я') {
+            result += QLatin1String(LETTERS[u - u'а']);
+        } else if (u == u'ё') {
+            result += QLatin1String("yo");
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+// Слова text.txt в порядке появления, чтобы частоты повторяли настоящий текст.
+const QStringList &vocabulary(Mix mix) {
+    static std::map<Mix, QStringList> words;
+    auto it = words.find(mix);
+    if (it != words.end()) return it->second;
+
+    const QStringList source = sourceText().toLower().split(QRegularExpression("[^a-zа-яё0-9]+"), Qt::SkipEmptyParts);
+    QStringList result;
+    for (qsizetype i = 0; i < source.size(); i++) {
+        const bool latin = mix == Latin || (mix == Mixed && i % 2 == 1);
+        result.append(latin ? transliterate(source.at(i)) : source.at(i));
+    }
+    return words.emplace(mix, result).first->second;
+}
+
+// Корпус из слов vocabulary(mix) размером около bytes байт UTF-8, со знаками препинания и переводами строк.
+QByteArray corpus(Mix mix, qint64 bytes) {
+    const QStringList &words = vocabulary(mix);
+    QByteArray text;
+    text.reserve(bytes + 64);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> separator(0, 15);
+    if (words.isEmpty()) return text;
+
+    qsizetype next = 0;
+    while (text.size() < bytes) {
+        text += words.at(next).toUtf8();
+        next = (next + 1) % words.size();
+        const int s = separator(rng);
+        text += s == 0 ? ",\n" : s == 1 ? ". " : " ";
+    }
+    text.truncate(bytes);
+    return text;
+}
+
+void setCorpusCounters(benchmark::State &state, qint64 bytes) {
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetLabel(MIX_NAMES[state.range(1)]);
+}
+
+// processText на корпусе в памяти: токенизация, приведение регистра и подсчёт
+void BM_ProcessText(benchmark::State &state) {
+    const QString text = QString::fromUtf8(corpus(static_cast<Mix>(state.range(1)), state.range(0)));
+    WordCloudGenerator generator;
+    for (auto _ : state) {
+        generator.processText(text);
+        benchmark::DoNotOptimize(generator.distinctWords());
+    }
+    setCorpusCounters(state, state.range(0));
+}
+
+// processFile с диска потоками по ядрам; память не зависит от размера, поэтому доходит до 1 ГБ
+void BM_ProcessFile(benchmark::State &state) {
+    QTemporaryFile file;
+    if (!file.open()) {
+        state.SkipWithError("can`t create a temporary file");
+        return;
+    }
+    // корпус пишется блоками по 16 МБ, чтобы не держать гигабайт в памяти
+    const qint64 block = std::min<qint64>(state.range(0), 16 << 20);
+    const QByteArray chunk = corpus(static_cast<Mix>(state.range(1)), block);
+    for (qint64 written = 0; written < state.range(0); written += block) {
+        file.write(chunk.constData(), std::min(block, state.range(0) - written));
+    }
+    file.flush();
+
+    WordCloudGenerator generator;
+    generator.setThreadCount(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    for (auto _ : state) {
+        if (!generator.processFile(file.fileName())) {
+            state.SkipWithError("can`t read the corpus");
+            return;
+        }
+        benchmark::DoNotOptimize(generator.distinctWords());
+    }
+    setCorpusCounters(state, state.range(0));
+}
+
+void corpusSizes(benchmark::internal::Benchmark *b, qint64 maxBytes) {
+    for (int mix = Cyrillic; mix <= Mixed; mix++) {
+        for (qint64 bytes = 1 << 10; bytes <= maxBytes; bytes *= 32) {
+            b->Args({bytes, mix});
+        }
+    }
+    b->ArgNames({"bytes", "mix"})->Unit(benchmark::kMillisecond);
+}
+
+// QString корпуса занимает вдвое больше UTF-8, а processText держит ещё копии, поэтому до 32 МБ
+BENCHMARK(BM_ProcessText)->Apply([](benchmark::internal::Benchmark *b) { corpusSizes(b, 32 << 20); });
+BENCHMARK(BM_ProcessFile)->Apply([](benchmark::internal::Benchmark *b) { corpusSizes(b, qint64(1) << 30); });
+
+// Индекс документных частот по 16 документам разных смесей и размеров, строится один раз.
+// Папка живёт до конца процесса: индекс открыт через mmap.
+std::shared_ptr<const IdfIndex> benchIdfIndex() {
+    static QTemporaryDir dir;
+    static const std::shared_ptr<const IdfIndex> index = []() -> std::shared_ptr<const IdfIndex> {
+        if (!dir.isValid()) return nullptr;
+        QStringList documents;
+        for (int i = 0; i < 16; i++) {
+            documents.append(dir.filePath(QString("doc%1.txt").arg(i)));
+            QFile file(documents.back());
+            if (!file.open(QIODevice::WriteOnly)) return nullptr;
+            file.write(corpus(static_cast<Mix>(i % 3), qint64(4096) << (i % 6)));
+        }
+        auto result = std::make_shared<IdfIndex>();
+        const QString path = dir.filePath("index.wcc");
+        if (!IdfIndex::build(documents, path, TokenNormalizer(), 1) || !result->open(path)) return nullptr;
+        return result;
+    }();
+    return index;
+}
+
+// TF-IDF от начала до конца: processText и раскладка 800x600 с индексом и без него на одном корпусе.
+// Время итерации - прогон с индексом, overhead_pct - на сколько процентов он дольше прогона без индекса.
+void BM_TfIdfOverhead(benchmark::State &state) {
+    const std::shared_ptr<const IdfIndex> index = benchIdfIndex();
+    if (!index) {
+        state.SkipWithError("can`t build the idf index");
+        return;
+    }
+    const QString text = QString::fromUtf8(corpus(static_cast<Mix>(state.range(1)), state.range(0)));
+    WordCloudGenerator plain;
+    WordCloudGenerator weighted;
+    weighted.setIdfIndex(index);
+
+    auto run = [&](WordCloudGenerator &generator) {
+        const auto start = std::chrono::steady_clock::now();
+        generator.processText(text);
+        benchmark::DoNotOptimize(generator.computeLayout(QSize(800, 600)).words.size());
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    double plainSeconds = 0;
+    double weightedSeconds = 0;
+    for (auto _ : state) {
+        plainSeconds += run(plain);
+        const double seconds = run(weighted);
+        weightedSeconds += seconds;
+        state.SetIterationTime(seconds);
+    }
+    setCorpusCounters(state, state.range(0));
+    state.counters["overhead_pct"] = plainSeconds > 0 ? (weightedSeconds / plainSeconds - 1) * 100 : 0;
+}
+
+BENCHMARK(BM_TfIdfOverhead)->Apply([](benchmark::internal::Benchmark *b) { corpusSizes(b, 32 << 20); })->UseManualTime();
+
+WordCloudGenerator &textGenerator() {
+    static WordCloudGenerator generator;
+    static const bool ready = (generator.processText(sourceText()), true);
+    Q_UNUSED(ready);
+    return generator;
+}
+
+// draw целиком (раскладка и отрисовка) для каждой формы на холсте 800x600
+void BM_Draw(benchmark::State &state, const QString &shape) {
+    WordCloudGenerator &generator = textGenerator();
+    generator.setShape(shape);
+    generator.setMaxWords(0);
+    QImage image(800, 600, QImage::Format_ARGB32);
+    for (auto _ : state) {
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        generator.draw(&painter, image.size());
+    }
+}
+
+// Раскладка (без растра) для n слов: время на слово видно в items_per_second
+void BM_LayoutWords(benchmark::State &state) {
+    // различные слова с убывающими частотами, чтобы у всех был разный кегль
+    WordCloudGenerator generator;
+    const QStringList &words = vocabulary(Mixed);
+    QStringList distinct;
+    for (const QString &word : words) {
+        if (!distinct.contains(word)) distinct.append(word);
+        if (distinct.size() >= state.range(0)) break;
+    }
+    for (qsizetype i = 0; i < distinct.size(); i++) {
+        for (qsizetype n = 0; n < distinct.size() - i; n++) generator.addWord(distinct.at(i));
+    }
+    generator.setMaxWords(static_cast<int>(state.range(0)));
+
+    size_t placed = 0;
+    for (auto _ : state) {
+        placed = generator.computeLayout(QSize(1600, 1200)).words.size();
+    }
+    state.SetItemsProcessed(state.iterations() * distinct.size());
+    state.counters["placed"] = static_cast<double>(placed);
+}
+
+BENCHMARK(BM_LayoutWords)->RangeMultiplier(2)->Range(25, 800)->ArgName("words")->Unit(benchmark::kMicrosecond);
+
+// Кодирование готовой раскладки 1600x1200 в каждый формат, размер результата - в счётчике bytes
+void BM_Encode(benchmark::State &state, OutputFormat format) {
+    WordCloudGenerator &generator = textGenerator();
+    generator.setShape("spiral");
+    const QSize size(1600, 1200);
+    const Layout layout = generator.computeLayout(size);
+    ImageOptions options;
+    options.format = format;
+
+    qint64 bytes = 0;
+    for (auto _ : state) {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (!writeImage(layout, size, options, buffer, &generator.glyphs())) {
+            state.SkipWithError("can`t encode the image");
+            return;
+        }
+        bytes = data.size();
+    }
+    state.counters["bytes"] = static_cast<double>(bytes);
+}
+
+}
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    QGuiApplication app(argc, argv);
+
+    for (const QString &shape : WordCloudGenerator::shapes()) {
+        benchmark::RegisterBenchmark(("BM_Draw/" + shape).toStdString().c_str(), BM_Draw, shape)
+            ->Unit(benchmark::kMillisecond);
+    }
+    for (const char *name : {"jpg", "png", "bmp", "raw", "svg", "pdf"}) {
+        OutputFormat format;
+        outputFormatFromName(name, format);
+        benchmark::RegisterBenchmark((std::string("BM_Encode/") + name).c_str(), BM_Encode, format)
+            ->Unit(benchmark::kMillisecond);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Сравнение std::map<QString, int> и WordCountTable на text.txt, повторённом SCALE раз.
+// Запуск: WordCountBench [путь к text.txt] [кратность]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QDebug>
+#include <map>
+#include <string>
+#include <vector>
+#include "../WordCountTable.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+
+    const QString inputFile = args.size() > 1 ? args.at(1) : QStringLiteral("../text.txt");
+    const int scale = args.size() > 2 ? args.at(2).toInt() : 1000;
+
+    QFile file(inputFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Error: Can`t open file" << inputFile;
+        return 1;
+    }
+
+    // токенизация одна и та же для обоих вариантов, измеряем только подсчёт
+    const QStringList words = QString::fromUtf8(file.readAll()).toLower()
+        .split(QRegularExpression("[^a-zа-яё0-9]+"), Qt::SkipEmptyParts);
+
+    std::vector<QString> tokens;
+    std::vector<std::string> utf8Tokens;
+    for (const QString &w : words) {
+        if (w.length() < 2) continue;
+        tokens.push_back(w);
+        utf8Tokens.push_back(w.toStdString());
+    }
+
+    const double totalTokens = double(tokens.size()) * scale;
+    QElapsedTimer timer;
+
+    timer.start();
+    std::map<QString, int> map;
+    for (int r = 0; r < scale; r++) {
+        for (const QString &w : tokens) map[w]++;
+    }
+    const qint64 mapNs = timer.nsecsElapsed();
+
+    timer.start();
+    WordCountTable table;
+    for (int r = 0; r < scale; r++) {
+        for (const std::string &w : utf8Tokens) table.add(w);
+    }
+    const qint64 tableNs = timer.nsecsElapsed();
+
+    if (map.size() != table.size()) {
+        qCritical() << "Error: distinct word counts differ" << map.size() << table.size();
+        return 1;
+    }
+
+    qInfo().noquote() << QString("tokens: %1, distinct: %2").arg(qint64(totalTokens)).arg(table.size());
+    qInfo().noquote() << QString("std::map<QString, int>: %1 ms, %2 ns/token")
+        .arg(mapNs / 1e6, 0, 'f', 1).arg(mapNs / totalTokens, 0, 'f', 2);
+    qInfo().noquote() << QString("WordCountTable:         %1 ms, %2 ns/token")
+        .arg(tableNs / 1e6, 0, 'f', 1).arg(tableNs / totalTokens, 0, 'f', 2);
+    qInfo().noquote() << QString("speedup: %1x").arg(double(mapNs) / tableNs, 0, 'f', 2);
+
+    return 0;
+}
@@ -14,6 +14,7 @@ mingw32-make
 echo Copying Qt libs
 copy "%QT%\bin\Qt6Core.dll" .
 copy "%QT%\bin\Qt6Gui.dll" .
+copy "%QT%\bin\Qt6Network.dll" .
 copy "%QT%\bin\libgcc_s_seh-1.dll" .
 copy "%QT%\bin\libstdc++-6.dll" .
 copy "%QT%\bin\libwinpthread-1.dll" .
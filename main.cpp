@@ -1,15 +1,417 @@
 #include <QGuiApplication>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
+#include <QBuffer>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonDocument>
 #include <QImage>
 #include <QPainter>
+#include <QSaveFile>
 #include <QStringList>
+#include <QThread>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <new>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
 #include "WordCloudGenerator.h"
+#include "Layout.h"
+#include "Batch.h"
+#include "CountSnapshot.h"
+#include "RenderServer.h"
+#include "ImageOutput.h"
+#include "RenderCache.h"
+#include "Profiler.h"
+#include "ResourceUsage.h"
+#include "Utf8Tokenizer.h"
+#include "Ingest.h"
+#include "TokenNormalizer.h"
+#include "IdfIndex.h"
+#include "ImageMask.h"
+#include "Shapes.h"
+
+// Глобальный operator new заменён только в программе, чтобы --stats считал выделения памяти;
+// пока запись выключена, это одна проверка флага поверх malloc.
+void *operator new(std::size_t size) {
+    Profiler::add(Profiler::Counter::Allocations);
+    while (true) {
+        if (void *p = std::malloc(size ? size : 1)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    Profiler::add(Profiler::Counter::Allocations);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
 
 bool isValidShape(const QString &shape) {
-    static const QStringList validShapes = {"spiral", "circle", "square", "triangle", "heart", "star"};
-   return validShapes.contains(shape.toLower());
+   return WordCloudGenerator::shapes().contains(shape.toLower());
+}
+
+// "spiral(maximum words: 50), circle(maximum words: 40), ..." из таблицы форм
+QString shapeHelp() {
+    QStringList items;
+    for (const ShapeInfo &shape : SHAPES) {
+        items.append(QString("%1(maximum words: %2)").arg(QString::fromLatin1(shape.name)).arg(shape.maxWords));
+    }
+    return items.join(", ");
+}
+
+// Куда и как рисовать: размеры, файл картинки ("-" - stdout), файл раскладки, формат.
+struct OutputOptions {
+    std::vector<QSize> sizes;
+    QString file;
+    QString layoutFile;
+    ImageOptions image;
+    RenderCache *cache = nullptr;
+    std::vector<QByteArray> cacheKeys;  // по ключу на размер, если кэш включён
+    bool printStats = false;
+    QString traceFile;
+};
+
+// Печатает --stats в stderr и пишет --trace; в режиме --follow отчёт за каждую перерисовку.
+void reportProfile(const OutputOptions &options) {
+    if (!Profiler::enabled()) return;
+    
+    if (options.printStats) {
+        qInfo().noquote() << QJsonDocument(Profiler::toJson()).toJson(QJsonDocument::Compact);
+    }
+    if (!options.traceFile.isEmpty()) {
+        QSaveFile file(options.traceFile);
+        if (!file.open(QIODevice::WriteOnly) || file.write(Profiler::traceJson()) < 0 || !file.commit()) {
+            qWarning() << "Warning: Can`t save the trace" << options.traceFile;
+        }
+    }
+    Profiler::reset();
+}
+
+// Хэш входа для ключа кэша. Один файл хэшируется целиком; для многих файлов берутся пути,
+// размеры и время изменения, иначе ради ключа пришлось бы второй раз прочитать весь корпус.
+QByteArray hashInputs(const QStringList &files) {
+    if (files.size() == 1) return RenderCache::hashFile(files.front());
+    
+    QByteArray listing;
+    for (const QString &path : files) {
+        const QFileInfo info(path);
+        if (!info.isFile()) return QByteArray();
+        listing += info.absoluteFilePath().toUtf8() + "\t" + QByteArray::number(info.size()) + "\t"
+            + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + "\n";
+    }
+    return RenderCache::hashData(listing);
+}
+
+// Стоп-слова (--stop-words en,ru,file.txt), --min-length и --stem; signature описывает их для ключа кэша.
+bool createNormalizer(const QCommandLineParser &parser, TokenNormalizer &normalizer, QString &signature) {
+    QStringList parts;
+    int languages = 0;
+    QStringList files;
+    
+    for (const QString &list : parser.value("stop-words").split(',', Qt::SkipEmptyParts)) {
+        if (list == "en") {
+            languages |= StopWordSet::English;
+        } else if (list == "ru") {
+            languages |= StopWordSet::Russian;
+        } else if (list != "none") {
+            files.append(list);
+        }
+    }
+    
+    StopWordSet stopWords(languages);
+    if (languages != 0) parts.append("stop=" + QString::number(languages));
+    
+    for (const QString &file : files) {
+        if (!stopWords.loadFile(file)) return false;
+        parts.append("stop=" + QString::fromLatin1(RenderCache::hashFile(file).toHex()));
+    }
+    
+    const int minLength = parser.value("min-length").toInt();
+    
+    if (minLength < 2) {
+        qCritical() << "Error: Minimum word length must be at least 2";
+        return false;
+    }
+    
+    normalizer.setStopWords(std::move(stopWords));
+    normalizer.setMinLength(minLength);
+    normalizer.setStemming(parser.isSet("stem"));
+    
+    if (normalizer.minLength() > 0) parts.append("min=" + QString::number(normalizer.minLength()));
+    if (normalizer.stems()) parts.append("stem");
+    signature = parts.join(' ');
+    return true;
+}
+
+// Открывает выходной файл (или stdout для "-") и отдаёт его write.
+bool writeToOutput(const QString &outputFile, const std::function<bool(QIODevice &)> &write) {
+    if (outputFile == "-") {
+#ifdef Q_OS_WIN
+        // иначе CRT заменит \n на \r\n прямо в картинке
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        QFile out;
+        if (!out.open(stdout, QIODevice::WriteOnly) || !write(out) || !out.flush()) {
+            qCritical() << "Error: Can`t write an image to stdout";
+            return false;
+        }
+        return true;
+    }
+    
+    QSaveFile file(outputFile);
+    
+    if (!file.open(QIODevice::WriteOnly) || !write(file) || !file.commit()) {
+        qCritical() << "Error: Can`t save an image" << outputFile;
+        return false;
+    }
+    return true;
+}
+
+bool writeBytes(const QString &outputFile, const QByteArray &bytes) {
+    return writeToOutput(outputFile, [&bytes](QIODevice &device) { return device.write(bytes) == bytes.size(); });
+}
+
+bool renderToFile(const Layout &layout, GlyphCache &glyphs, const QSize &size, const QString &outputFile,
+                  const OutputOptions &options, const QByteArray &cacheKey) {
+    if (options.cache == nullptr) {
+        return writeToOutput(outputFile, [&](QIODevice &device) {
+            return writeImage(layout, size, options.image, device, &glyphs);
+        });
+    }
+    
+    // с кэшем картинка собирается в памяти, чтобы те же байты ушли и в файл, и в кэш
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    
+    if (!writeImage(layout, size, options.image, buffer, &glyphs)) {
+        qCritical() << "Error: Can`t render an image" << outputFile;
+        return false;
+    }
+    options.cache->store(cacheKey, bytes);
+    return writeBytes(outputFile, bytes);
+}
+
+// Суффикс вставляется перед расширением: output.jpg -> output_<suffix>.jpg
+QString suffixedOutputName(const QString &outputFile, const QString &suffix) {
+    qsizetype dot = outputFile.lastIndexOf('.');
+    // без расширения (или точка только в имени папки) суффикс идёт в конец
+    if (dot <= outputFile.lastIndexOf('/')) dot = outputFile.size();
+    return outputFile.left(dot) + '_' + suffix + outputFile.mid(dot);
+}
+
+// При нескольких размерах к имени файла добавляется размер: output_1600x1200.jpg
+QString sizedOutputName(const QString &outputFile, const QSize &size) {
+    return suffixedOutputName(outputFile, QString("%1x%2").arg(size.width()).arg(size.height()));
+}
+
+// Одна раскладка считается для первого размера и рисуется во всех остальных.
+bool renderAll(WordCloudGenerator &generator, const OutputOptions &options) {
+    const Layout layout = generator.computeLayout(options.sizes.front());
+    
+    if (!options.layoutFile.isEmpty()) {
+        QSaveFile file(options.layoutFile);
+        if (!file.open(QIODevice::WriteOnly) || file.write(layout.toJson()) < 0 || !file.commit()) {
+            qCritical() << "Error: Can`t save the layout" << options.layoutFile;
+            return false;
+        }
+    }
+    
+    for (size_t i = 0; i < options.sizes.size(); i++) {
+        const QSize &size = options.sizes[i];
+        const QString name = options.sizes.size() > 1 ? sizedOutputName(options.file, size) : options.file;
+        const QByteArray cacheKey = options.cache != nullptr ? options.cacheKeys[i] : QByteArray();
+        if (!renderToFile(layout, generator.glyphs(), size, name, options, cacheKey)) return false;
+    }
+    
+    Profiler::set(Profiler::Counter::DistinctWords, static_cast<qint64>(generator.distinctWords()));
+    reportProfile(options);
+    return true;
+}
+
+// Следит за дописываемым файлом: новые строки добавляются к частотам, самые старые
+// выпадают из окна windowBytes (0 - без окна), картинка перерисовывается каждые intervalMs.
+int followFile(WordCloudGenerator &generator, const QString &inputFile, qint64 windowBytes, int intervalMs,
+               const OutputOptions &options) {
+    QFile file(inputFile);
+    
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qCritical() << "Error: Can`t open file" << inputFile;
+        return 1;
+    }
+    
+    std::deque<QByteArray> window;
+    qint64 windowSize = 0;
+    QByteArray pending;
+    QByteArray chunk(WordCloudGenerator::STREAM_CHUNK_SIZE, Qt::Uninitialized);
+    bool discarding = false;  // отбрасываем хвост слишком длинного "слова" до следующего разделителя
+    
+    while (true) {
+        if (file.size() < file.pos()) {
+            // файл обрезали или перезаписали - начинаем заново
+            file.seek(0);
+            generator.clear();
+            window.clear();
+            windowSize = 0;
+            pending.clear();
+            discarding = false;
+        }
+        
+        // и уже записанное, и дописанное читается блоками, как в processFile;
+        // картинка перерисовывается один раз, когда прочитано всё
+        bool grown = false;
+        qint64 bytesRead;
+        while ((bytesRead = file.read(chunk.data(), chunk.size())) > 0) {
+            pending.append(chunk.constData(), bytesRead);
+            
+            if (discarding) {
+                qsizetype start = 0;
+                while (start < pending.size() && !Utf8Tokenizer::isSeparator(pending[start])) start++;
+                pending.remove(0, start);
+                discarding = pending.isEmpty();
+                if (discarding) continue;
+            }
+            
+            // незаконченное слово в конце ждёт следующего блока
+            qsizetype cut = pending.size();
+            while (cut > 0 && !Utf8Tokenizer::isSeparator(pending[cut - 1])) cut--;
+            if (cut == 0) {
+                // строка без разделителей длиннее блока - не слово; не копим её, а пропускаем целиком
+                if (pending.size() > WordCloudGenerator::STREAM_CHUNK_SIZE) {
+                    pending.clear();
+                    discarding = true;
+                }
+                continue;
+            }
+            
+            QByteArray segment = pending.left(cut);
+            pending.remove(0, cut);
+            generator.addUtf8(segment);
+            grown = true;
+            
+            // без окна текст не хранится: из частот ничего не убирается
+            if (windowBytes <= 0) continue;
+            windowSize += segment.size();
+            window.push_back(std::move(segment));
+            while (windowSize > windowBytes && window.size() > 1) {
+                generator.removeUtf8(window.front());
+                windowSize -= window.front().size();
+                window.pop_front();
+            }
+        }
+        
+        if (grown && !renderAll(generator, options)) return 1;
+        
+        QThread::msleep(intervalMs);
+    }
+}
+
+// Номер кадра добавляется к имени файла: output_0001.png
+QString frameOutputName(const QString &outputFile, qsizetype frame) {
+    return suffixedOutputName(outputFile, QString("%1").arg(frame, 4, 10, QChar('0')));
+}
+
+// Анимация: каждый входной файл - срез текста и кадр, в порядке аргументов (папки и маски - по алфавиту).
+// Раскладка переходит из кадра в кадр (computeFrame), а растровый кадр рисуется поверх предыдущего
+// только в изменившихся местах.
+// Кадры пишутся в файлы с номерами, в stdout - подряд (raw удобно отдавать в ffmpeg).
+int renderSequence(WordCloudGenerator &generator, const QStringList &slices, const OutputOptions &options) {
+    const QSize size = options.sizes.front();
+    const bool raster = options.image.format != OutputFormat::Svg && options.image.format != OutputFormat::Pdf;
+    const bool toStdout = options.file == "-";
+    
+    WordCloudGenerator::FrameState state;
+    std::vector<QRect> dirty;
+    QImage frame(size, QImage::Format_ARGB32);
+    frame.fill(Qt::white);
+    qint64 placed = 0;
+    qint64 removed = 0;
+    
+    for (qsizetype i = 0; i < slices.size(); i++) {
+        if (!generator.processFile(slices.at(i))) {
+            qCritical() << "Error: Can`t read file" << slices.at(i);
+            return 1;
+        }
+        
+        const Layout layout = generator.computeFrame(size, state, dirty);
+        placed += state.placed;
+        removed += state.removed;
+        
+        const QString name = toStdout ? options.file : frameOutputName(options.file, i + 1);
+        bool written = false;
+        
+        if (raster) {
+            layout.repaint(frame, dirty, &generator.glyphs());
+            written = writeToOutput(name, [&](QIODevice &device) { return writeRaster(frame, options.image, device); });
+        } else {
+            written = writeToOutput(name, [&](QIODevice &device) {
+                return writeImage(layout, size, options.image, device, &generator.glyphs());
+            });
+        }
+        if (!written) return 1;
+    }
+    
+    qInfo() << "Frames:" << slices.size() << "words placed:" << placed << "removed:" << removed;
+    reportProfile(options);
+    return 0;
+}
+
+// Обработанная маска берётся из кэша картинок по хэшу файла, иначе строится и кладётся туда.
+std::shared_ptr<ImageMask> loadMask(const QString &path, RenderCache *cache) {
+    auto mask = std::make_shared<ImageMask>();
+    QByteArray key;
+    
+    if (cache != nullptr) {
+        key = RenderCache::key(RenderCache::hashFile(path), {"mask", QString::number(ImageMask::VERSION)});
+        QByteArray bytes;
+        if (cache->lookup(key, bytes) && mask->fromBytes(bytes)) return mask;
+    }
+    
+    if (!mask->load(path)) {
+        qCritical() << "Error: Can`t read mask image or it has no opaque pixels" << path;
+        return nullptr;
+    }
+    
+    if (cache != nullptr) cache->store(key, mask->toBytes());
+    return mask;
+}
+
+std::unique_ptr<RenderCache> createCache(const QCommandLineParser &parser) {
+    const qint64 megabytes = parser.value("cache-size").toLongLong();
+    
+    if (megabytes < 1) {
+        qCritical() << "Error: Cache size must be at least 1 MiB";
+        return nullptr;
+    }
+    
+    auto cache = std::make_unique<RenderCache>(parser.value("cache"), megabytes << 20);
+    
+    if (!cache->isValid()) {
+        qCritical() << "Error: Can`t create cache directory" << parser.value("cache");
+        return nullptr;
+    }
+    return cache;
 }
 
 int main(int argc, char *argv[]) {
@@ -23,35 +425,251 @@ int main(int argc, char *argv[]) {
     parser.addHelpOption();
     parser.addVersionOption();
     
-    parser.addPositionalArgument("input", "Input text file");
+    parser.addPositionalArgument("inputs",
+        "Input text files, directories (all *.txt inside), masks (texts/*.txt) or @list files with one path per line; "
+        "or: merge <output> <snapshots...> to merge counts snapshots; "
+        "or: index <output> <documents...> to build a document frequency index for --idf");
     
     parser.addOption(QCommandLineOption({"o", "output"},
-        "Output .jpg file", "file", "output.jpg"));
+        "Output image: .jpg, .png, .bmp, .raw (BGRA pixels), .svg or .pdf; - writes to stdout", "file", "output.jpg"));
+    
+    parser.addOption(QCommandLineOption("format",
+        "Output format: jpg, png, bmp, raw, svg or pdf (default: from the output extension, jpg for stdout)", "format"));
+    
+    parser.addOption(QCommandLineOption("png-level",
+        "PNG compression level from 0 (fastest) to 9 (smallest)", "level", "-1"));
     
     parser.addOption(QCommandLineOption({"s", "shape"}, 
-        "Cloud shape: spiral(maximum words: 50), circle(maximum words: 40), square(maximum words: 40), triangle(maximum words: 36), heart(maximum words: 48), star(maximum words: 50)", 
+        "Cloud shape: " + shapeHelp(), 
         "shape", "spiral"));
     
+    parser.addOption(QCommandLineOption("mask",
+        "Image whose opaque pixels (dark pixels if it has no alpha channel) define where words go; replaces --shape", "image"));
+    
     parser.addOption(QCommandLineOption({"W", "width"}, 
-        "Image width in pixels (minimum 100)", "pixels", "800"));
+        "Image width in pixels (minimum 100); repeat -W/-H to render several sizes from one layout", "pixels", "800"));
     
     parser.addOption(QCommandLineOption({"H", "height"}, 
         "Image height in pixels (minimum 100)", "pixels", "600"));
     
+    parser.addOption(QCommandLineOption("scale",
+        "Comma-separated scale factors of the first size to render as well, e.g. 0.25,2", "factors"));
+    
+    parser.addOption(QCommandLineOption("tile",
+        "Render in tiles of this size on -j threads and stream the rows into a .bmp or .raw (for poster sizes)",
+        "pixels", "0"));
+    
+    parser.addOption(QCommandLineOption("save-layout",
+        "Save the computed layout as JSON", "file"));
+    
+    const int defaultThreads = std::max(1u, std::thread::hardware_concurrency());
+    parser.addOption(QCommandLineOption({"j", "threads"},
+        "Number of threads used to count words (default: number of CPU cores)", "count",
+        QString::number(defaultThreads)));
+    
+    parser.addOption(QCommandLineOption("io-threads",
+        "Number of threads reading input files when there are several of them", "count", "4"));
+    
+    parser.addOption(QCommandLineOption("stop-words",
+        "Drop stop words: comma-separated built-in lists (en, ru) and files with one word per line", "lists"));
+    
+    parser.addOption(QCommandLineOption("min-length",
+        "Drop words shorter than this many characters", "chars", "2"));
+    
+    parser.addOption(QCommandLineOption("stem",
+        "Cut common word endings (Russian cases and verb forms, English plurals) so word forms are counted together"));
+    
+    parser.addOption(QCommandLineOption("idf",
+        "Weight word counts by inverse document frequency from an index built with the index command", "index"));
+    
+    parser.addOption(QCommandLineOption("words",
+        "Maximum number of words to place (default: the shape's limit)", "count", "0"));
+    
+    parser.addOption(QCommandLineOption("sequence",
+        "Render every input file as one animation frame; unchanged words keep their places between frames"));
+    
+    parser.addOption(QCommandLineOption("follow",
+        "Keep reading the input file as it grows and re-render the image"));
+    
+    parser.addOption(QCommandLineOption("interval",
+        "Re-render interval in follow mode", "ms", "2000"));
+    
+    parser.addOption(QCommandLineOption("window",
+        "Count only the most recent bytes of the followed file (0 = whole file)", "bytes", "0"));
+    
+    parser.addOption(QCommandLineOption("approx",
+        "Count approximately with a fixed number of counters (0 = exact counting)", "counters", "0"));
+    
+    parser.addOption(QCommandLineOption("approx-sketch",
+        "Width of the Count-Min sketch that refines approximate counts (0 = none)", "width", "0"));
+    
+    parser.addOption(QCommandLineOption("peak-rss",
+        "Print peak resident memory usage after rendering"));
+    
+    parser.addOption(QCommandLineOption("save-counts",
+        "Save the word counts as a binary snapshot", "file"));
+    
+    parser.addOption(QCommandLineOption("load-counts",
+        "Take the word counts from a binary snapshot instead of an input text file", "file"));
+    
+    parser.addOption(QCommandLineOption("cache",
+        "Reuse images rendered earlier from the same input and options; images are kept in this directory",
+        "directory"));
+    
+    parser.addOption(QCommandLineOption("cache-size",
+        "Maximum size of the render cache; least recently used images are removed beyond it", "MiB", "256"));
+    
+    parser.addOption(QCommandLineOption("stats",
+        "Print per-stage timings and counters as JSON to stderr (in server mode: add them to stats responses)"));
+    
+    parser.addOption(QCommandLineOption("trace",
+        "Save stage timings as a Chrome trace (chrome://tracing, Perfetto)", "file"));
+    
+    parser.addOption(QCommandLineOption("batch",
+        "Render every job of a tab-separated manifest (input, shape, width, height, output[, seed]) "
+        "on a pool of --threads workers instead of a single input", "manifest"));
+    
+    parser.addOption(QCommandLineOption("serve",
+        "Run as a render server on a local socket; -j sets the number of render workers", "name"));
+    
+    parser.addOption(QCommandLineOption("queue",
+        "Maximum number of requests the server renders or queues at once", "count", "64"));
+    
+    parser.addOption(QCommandLineOption("serve-root",
+        "Directory the server may read \"file\" requests from; without it only inline text is accepted", "directory"));
+    
     parser.process(app);
     
+    if (parser.isSet("trace")) {
+        Profiler::setTracing(true);
+    } else if (parser.isSet("stats")) {
+        Profiler::setEnabled(true);
+    }
+    
+    int threads = parser.value("threads").toInt();
+    
+    if (threads < 1) {
+        qCritical() << "Error: Thread count must be at least 1";
+        return 1;
+    }
+    
+    int words = parser.value("words").toInt();
+    
+    if (words < 0) {
+        qCritical() << "Error: Word count must be non-negative";
+        return 1;
+    }
+    
+    if (parser.isSet("batch")) {
+        std::vector<BatchJob> jobs;
+        
+        if (!parseManifest(parser.value("batch"), jobs)) {
+            return 1;
+        }
+        
+        int failed = runBatch(jobs, threads, words);
+        qInfo() << "Batch finished:" << jobs.size() - failed << "of" << jobs.size() << "jobs succeeded";
+        
+        OutputOptions report;
+        report.printStats = parser.isSet("stats");
+        report.traceFile = parser.value("trace");
+        reportProfile(report);
+        return failed == 0 ? 0 : 1;
+    }
+    
+    if (parser.isSet("serve")) {
+        int queue = parser.value("queue").toInt();
+        
+        if (queue < 1) {
+            qCritical() << "Error: Queue size must be at least 1";
+            return 1;
+        }
+        
+        RenderServer server(threads, queue);
+        
+        if (parser.isSet("serve-root") && !server.setFileRoot(parser.value("serve-root"))) {
+            qCritical() << "Error: Can`t find the server root directory" << parser.value("serve-root");
+            return 1;
+        }
+        std::unique_ptr<RenderCache> cache;
+        
+        if (parser.isSet("cache")) {
+            cache = createCache(parser);
+            if (!cache) return 1;
+            server.setCache(cache.get());
+        }
+        
+        if (!server.listen(parser.value("serve"))) {
+            return 1;
+        }
+        
+        qInfo() << "Listening on" << server.fullServerName();
+        return app.exec();
+    }
+    
     const QStringList args = parser.positionalArguments();
+    
+    if (!args.isEmpty() && args.at(0) == "merge") {
+        if (args.size() < 3) {
+            qCritical() << "Error: merge needs an output file and at least one snapshot";
+            return 1;
+        }
+        return mergeCountSnapshots(args.mid(2), args.at(1)) ? 0 : 1;
+    }
+    
+    if (!args.isEmpty() && args.at(0) == "index") {
+        if (args.size() < 3) {
+            qCritical() << "Error: index needs an output file and at least one document";
+            return 1;
+        }
+        
+        QStringList documents;
+        TokenNormalizer normalizer;
+        QString signature;
+        
+        if (!collectInputFiles(args.mid(2), documents) || !createNormalizer(parser, normalizer, signature)
+            || !IdfIndex::build(documents, args.at(1), normalizer, threads)) {
+            return 1;
+        }
+        
+        qInfo() << "Indexed" << documents.size() << "documents into" << args.at(1);
+        return 0;
+    }
+    
+    const QString countsFile = parser.value("load-counts");
 
-    if (args.isEmpty()) {
+    if (args.isEmpty() && countsFile.isEmpty()) {
         qCritical() << "Error: no text file";
         return 1;
     }
     
-    QString inputFile = args.at(0);
-
-    if (!inputFile.endsWith(".txt", Qt::CaseInsensitive)) {
-        qCritical() << "Error: Input file must have .txt extension";
-        qCritical() << "Got:" << inputFile;
+    if (!countsFile.isEmpty() && !args.isEmpty()) {
+        qCritical() << "Error: --load-counts replaces the text files and can`t be combined with them";
+        return 1;
+    }
+    
+    if (!countsFile.isEmpty() && parser.isSet("follow")) {
+        qCritical() << "Error: --load-counts can`t be combined with --follow";
+        return 1;
+    }
+    
+    QStringList inputFiles;
+    
+    if (countsFile.isEmpty() && !collectInputFiles(args, inputFiles)) {
+        return 1;
+    }
+    
+    const QString inputFile = inputFiles.isEmpty() ? QString() : inputFiles.front();
+    
+    if (inputFiles.size() > 1 && parser.isSet("follow")) {
+        qCritical() << "Error: --follow needs a single input file";
+        return 1;
+    }
+    
+    int ioThreads = parser.value("io-threads").toInt();
+    
+    if (ioThreads < 1) {
+        qCritical() << "Error: I/O thread count must be at least 1";
         return 1;
     }
 
@@ -60,63 +678,299 @@ int main(int argc, char *argv[]) {
     
     if (!isValidShape(shapeStr)) {
         qCritical() << "Error: Unknown shape:" << shapeStr;
-        qCritical() << "Available shapes: spiral, circle, square, triangle, heart, star";
+        qCritical() << "Available shapes:" << qPrintable(shapeNames().join(", "));
         return 1;
     }
     
-    int width = parser.value("width").toInt();
-    int height = parser.value("height").toInt();
+    const QStringList widths = parser.values("width");
+    const QStringList heights = parser.values("height");
     
-    if (width < 100 || height < 100) {
-        qCritical() << "Error: Minimum image size is 100 by 100 pixels";
+    if (widths.size() != heights.size()) {
+        qCritical() << "Error: Every -W needs a matching -H";
         return 1;
     }
     
-    QFile file(inputFile);
-
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qCritical() << "Error: Can`t open file" << inputFile;
-        return 1;
+    std::vector<QSize> sizes;
+    for (qsizetype i = 0; i < widths.size(); i++) {
+        int width = widths.at(i).toInt();
+        int height = heights.at(i).toInt();
+        
+        if (width < 100 || height < 100) {
+            qCritical() << "Error: Minimum image size is 100 by 100 pixels";
+            return 1;
+        }
+        sizes.push_back(QSize(width, height));
+    }
+    
+    if (parser.isSet("scale")) {
+        for (const QString &factor : parser.value("scale").split(',', Qt::SkipEmptyParts)) {
+            bool ok = false;
+            double scale = factor.toDouble(&ok);
+            QSize size(qRound(sizes.front().width() * scale), qRound(sizes.front().height() * scale));
+            
+            if (!ok || size.width() < 1 || size.height() < 1) {
+                qCritical() << "Error: Invalid scale factor:" << factor;
+                return 1;
+            }
+            sizes.push_back(size);
+        }
     }
     
-    QString text = QString::fromUtf8(file.readAll());
-    file.close();
+    int tileSize = parser.value("tile").toInt();
     
-    if (text.isEmpty()) {
-        qCritical() << "Error: File is empty";
+    if (tileSize < 0 || (tileSize > 0 && tileSize < 16)) {
+        qCritical() << "Error: Tile size must be at least 16 pixels";
         return 1;
     }
     
-    WordCloudGenerator generator;
+    ImageOptions image;
+    image.tileSize = tileSize;
+    image.threads = threads;
+    image.pngLevel = parser.value("png-level").toInt();
     
-    generator.setShape(shapeStr);
+    if (image.pngLevel < -1 || image.pngLevel > 9) {
+        qCritical() << "Error: PNG compression level must be from 0 to 9";
+        return 1;
+    }
     
-    generator.processText(text);
+    const bool toStdout = outputFile == "-";
+    OutputFormat named = OutputFormat::Jpeg;
+    const bool knownExtension = !toStdout && outputFormatFromName(QFileInfo(outputFile).suffix(), named);
     
-    QImage image(width, height, QImage::Format_ARGB32);
-    image.fill(Qt::white);
+    if (parser.isSet("format")) {
+        if (!outputFormatFromName(parser.value("format"), image.format)) {
+            qCritical() << "Error: Unknown output format:" << parser.value("format");
+            return 1;
+        }
+    } else if (knownExtension) {
+        image.format = named;
+    } else {
+        image.format = tileSize > 0 ? OutputFormat::Bmp : OutputFormat::Jpeg;
+    }
     
-    QPainter painter(&image);
-    generator.draw(&painter, image.size());
-    painter.end();
+    if (tileSize > 0 && (image.format == OutputFormat::Jpeg || image.format == OutputFormat::Png)) {
+        qCritical() << "Error: Tiled rendering writes only bmp, raw, svg or pdf";
+        return 1;
+    }
     
-    QString outputFileLower = outputFile.toLower();
+    if (toStdout && sizes.size() > 1) {
+        qCritical() << "Error: Only one image size can be written to stdout";
+        return 1;
+    }
     
-    if (!outputFileLower.endsWith(".jpg") && !outputFileLower.endsWith(".jpeg")) {
+    if (!toStdout && (!knownExtension || named != image.format)) {
+        const QString extension = "." + outputFormatExtension(image.format);
         if (!outputFile.contains('.')) {
-            outputFile += ".jpg";
+            outputFile += extension;
         } else {
             int lastDot = outputFile.lastIndexOf('.');
-            outputFile = outputFile.left(lastDot) + ".jpg";
+            outputFile = outputFile.left(lastDot) + extension;
         }
-        qInfo() << "File`s extension was changed to .jpg:" << outputFile;
+        qInfo() << "File`s extension was changed to" << extension << outputFile;
     }
     
-    if (!image.save(outputFile, "JPG", 100)) {
-        qCritical() << "Error: Can`t save an image" << outputFile;
+    OutputOptions output;
+    output.sizes = sizes;
+    output.file = outputFile;
+    output.layoutFile = parser.value("save-layout");
+    output.image = image;
+    output.printStats = parser.isSet("stats");
+    output.traceFile = parser.value("trace");
+    
+    qint64 approxCounters = parser.value("approx").toLongLong();
+    qint64 approxSketch = parser.value("approx-sketch").toLongLong();
+    
+    if (approxCounters < 0 || approxSketch < 0) {
+        qCritical() << "Error: Approximate counter and sketch sizes must be non-negative";
+        return 1;
+    }
+    
+    TokenNormalizer normalizer;
+    QString normalizerSignature;
+    
+    if (!createNormalizer(parser, normalizer, normalizerSignature)) {
+        return 1;
+    }
+    
+    std::shared_ptr<IdfIndex> idfIndex;
+    // нормализация влияет только на подсчёт текста, веса idf и маска - и на снимки частот
+    QStringList extraParameters;
+    if (countsFile.isEmpty() && !normalizerSignature.isEmpty()) extraParameters.append(normalizerSignature);
+    
+    if (parser.isSet("idf")) {
+        idfIndex = std::make_shared<IdfIndex>();
+        
+        if (!idfIndex->open(parser.value("idf"))) {
+            qCritical() << "Error: Can`t read document frequency index" << parser.value("idf");
+            return 1;
+        }
+        extraParameters.append("idf=" + QString::fromLatin1(RenderCache::hashFile(parser.value("idf")).toHex()));
+    }
+    
+    if (parser.isSet("mask")) {
+        const QByteArray maskHash = RenderCache::hashFile(parser.value("mask"));
+        
+        if (maskHash.isEmpty()) {
+            qCritical() << "Error: Can`t read mask image" << parser.value("mask");
+            return 1;
+        }
+        extraParameters.append("mask=" + QString::fromLatin1(maskHash.toHex()));
+    }
+    
+    std::unique_ptr<RenderCache> cache;
+    
+    if (parser.isSet("sequence") && (!countsFile.isEmpty() || parser.isSet("follow") || tileSize > 0 || sizes.size() > 1)) {
+        qCritical() << "Error: --sequence renders text files at one size and can`t be combined with --load-counts, --follow or --tile";
         return 1;
     }
     
+    if (parser.isSet("cache") && (parser.isSet("follow") || parser.isSet("sequence") || tileSize > 0)) {
+        qInfo() << "Render cache is not used with --follow, --sequence and --tile";
+    } else if (parser.isSet("cache")) {
+        cache = createCache(parser);
+        if (!cache) return 1;
+        
+        const QString source = countsFile.isEmpty() ? "text" : "counts";
+        std::vector<QByteArray> images(sizes.size());
+        bool allCached = true;
+        {
+            Profiler::Scope scope(Profiler::Stage::Cache);
+            const QByteArray inputHash = countsFile.isEmpty() ? hashInputs(inputFiles) : RenderCache::hashFile(countsFile);
+            
+            if (inputHash.isEmpty()) {
+                qCritical() << "Error: Can`t read input" << (countsFile.isEmpty() ? args.join(' ') : countsFile);
+                return 1;
+            }
+            
+            for (size_t i = 0; i < sizes.size(); i++) {
+                output.cacheKeys.push_back(RenderCache::key(inputHash,
+                    cloudCacheParameters(source, shapeStr, sizes[i], image, WordCloudGenerator::DEFAULT_SEED, words,
+                                         approxCounters, approxSketch,
+                                         extraParameters.join(' '))));
+                allCached = cache->lookup(output.cacheKeys.back(), images[i]) && allCached;
+            }
+        }
+        output.cache = cache.get();
+        
+        // всё уже нарисовано: генератор не нужен, если не просят раскладку или частоты
+        if (allCached && output.layoutFile.isEmpty() && !parser.isSet("save-counts")) {
+            for (size_t i = 0; i < sizes.size(); i++) {
+                const QString name = sizes.size() > 1 ? sizedOutputName(outputFile, sizes[i]) : outputFile;
+                if (!writeBytes(name, images[i])) return 1;
+            }
+            qInfo() << "Render cache: hits" << cache->hits() << "misses" << cache->misses();
+            reportProfile(output);
+            return 0;
+        }
+    }
+    
+    std::shared_ptr<ImageMask> mask;
+    
+    if (parser.isSet("mask")) {
+        Profiler::Scope scope(Profiler::Stage::Layout);
+        mask = loadMask(parser.value("mask"), cache.get());
+        if (!mask) return 1;
+    }
+    
+    WordCloudGenerator generator;
+    
+    generator.setShape(shapeStr);
+    generator.setMask(mask);
+    generator.setThreadCount(threads);
+    
+    generator.setMaxWords(words);
+    generator.setNormalizer(std::move(normalizer));
+    generator.setIdfIndex(idfIndex);
+    
+    if (approxCounters > 0) {
+        if (parser.isSet("follow") && parser.value("window").toLongLong() > 0) {
+            qCritical() << "Error: --approx can`t be combined with --window";
+            return 1;
+        }
+        generator.setApproximate(approxCounters, approxSketch);
+    }
+    
+    if (parser.isSet("sequence")) {
+        return renderSequence(generator, inputFiles, output);
+    }
+    
+    if (parser.isSet("follow")) {
+        int interval = parser.value("interval").toInt();
+        qint64 window = parser.value("window").toLongLong();
+        
+        if (interval < 1 || window < 0) {
+            qCritical() << "Error: Interval must be positive and window non-negative";
+            return 1;
+        }
+        
+        return followFile(generator, inputFile, window, interval, output);
+    }
+    
+    if (!countsFile.isEmpty()) {
+        if (!generator.loadCounts(countsFile)) {
+            qCritical() << "Error: Can`t read counts snapshot" << countsFile;
+            return 1;
+        }
+    } else if (inputFiles.size() > 1) {
+        IngestOptions ingest;
+        ingest.readers = ioThreads;
+        IngestStats stats;
+        
+        if (!generator.processFiles(inputFiles, ingest, &stats)) {
+            return 1;
+        }
+        
+        if (stats.bytes == 0) {
+            qCritical() << "Error: Input files are empty";
+            return 1;
+        }
+        
+        for (const QString &line : stats.summary()) {
+            qInfo().noquote() << line;
+        }
+    } else {
+        QFile file(inputFile);
+        
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCritical() << "Error: Can`t open file" << inputFile;
+            return 1;
+        }
+        
+        bool isEmpty = file.atEnd();
+        file.close();
+        
+        if (isEmpty) {
+            qCritical() << "Error: File is empty";
+            return 1;
+        }
+        
+        if (!generator.processFile(inputFile)) {
+            qCritical() << "Error: Can`t read file" << inputFile;
+            return 1;
+        }
+    }
+    
+    if (parser.isSet("save-counts") && !generator.saveCounts(parser.value("save-counts"))) {
+        qCritical() << "Error: Can`t save counts snapshot" << parser.value("save-counts");
+        return 1;
+    }
+    
+    if (approxCounters > 0) {
+        qInfo() << "Approximate counts overestimate by at most" << generator.approximationError();
+    }
+    
+    if (!renderAll(generator, output)) {
+        return 1;
+    }
+    
+    if (cache) {
+        qInfo() << "Render cache: hits" << cache->hits() << "misses" << cache->misses();
+    }
+    
+    if (parser.isSet("peak-rss")) {
+        qInfo() << "Peak RSS:" << peakRssBytes() / 1024 << "KiB";
+    }
+    
     return 0;
 
 }
@@ -1,8 +1,37 @@
 #include <gtest/gtest.h>
 #include "../WordCloudGenerator.h"
+#include "../WordCountTable.h"
+#include "../Utf8Tokenizer.h"
+#include "../GlyphCache.h"
+#include "../WordPlacer.h"
+#include "../Batch.h"
+#include "../CountSnapshot.h"
+#include "../RenderServer.h"
+#include "../RenderCache.h"
+#include "../TiledRenderer.h"
+#include "../ImageOutput.h"
+#include "../Profiler.h"
+#include "../Ingest.h"
+#include "../StopWords.h"
+#include "../TokenNormalizer.h"
+#include "../IdfIndex.h"
+#include "../Shapes.h"
+#include "../ImageMask.h"
+#include <QBuffer>
 #include <QImage>
 #include <QPainter>
 #include <QGuiApplication>
+#include <QTemporaryFile>
+#include <QTemporaryDir>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QTimer>
+#include <cmath>
+#include <thread>
 
 TEST(WordCloudTest, DifferentShapes) {  // отрисовка разных форм
     int argc = 1;
@@ -67,3 +96,808 @@ TEST(WordCloudTest, WrongShape) {  // задаём отсутствющую фо
     EXPECT_NO_THROW(generator.draw(&painter, image.size()));
     image.save(QString("test_boogy.jpg"));
 }
+
+TEST(WordCloudTest, StreamingMatchesProcessText) {  // потоковое чтение даёт те же частоты, что и processText
+    const QString text = QString::fromUtf8("Мой дядя самых честных правил, когда не в шутку занемог!\n"
+                                           "Hello, hello WORLD 42 ёлка Ёлка a б x1 x1 x1");
+    QTemporaryFile file;
+    ASSERT_TRUE(file.open());
+    file.write(text.toUtf8());
+    file.flush();
+
+    WordCloudGenerator expected;
+    expected.processText(text);
+
+    for (qint64 chunkSize : {1, 3, 7, 1 << 20}) {  // блоки режут и слова, и многобайтовые символы
+        WordCloudGenerator streamed;
+        ASSERT_TRUE(streamed.processFile(file.fileName(), chunkSize));
+        EXPECT_EQ(streamed.frequencies(), expected.frequencies());
+    }
+}
+
+TEST(WordCloudTest, WordCountTable) {  // счётчик переживает рост таблицы и не путает ключи
+    WordCountTable table;
+    for (int i = 0; i < 5000; i++) {
+        const std::string word = "w" + std::to_string(i % 2000);
+        table.add(word);
+    }
+
+    EXPECT_EQ(table.size(), 2000u);
+    EXPECT_EQ(table.count("w0"), 3);
+    EXPECT_EQ(table.count("w1999"), 2);
+    EXPECT_EQ(table.count("missing"), 0);
+
+    WordCountTable::Count total = 0;
+    table.forEach([&](std::string_view, WordCountTable::Count n) { total += n; });
+    EXPECT_EQ(total, 5000);
+}
+
+TEST(WordCloudTest, ParallelMatchesSequential) {  // многопоточный подсчёт совпадает с однопоточным
+    QString text;
+    for (int i = 0; i < 500; i++) {
+        text += QString::fromUtf8("Мой дядя самых честных правил; word%1, WORD%2 ёж-%3 x\n").arg(i % 37).arg(i % 11).arg(i);
+    }
+
+    WordCloudGenerator sequential;
+    sequential.processText(text);
+
+    QTemporaryFile file;
+    ASSERT_TRUE(file.open());
+    file.write(text.toUtf8());
+    file.flush();
+
+    for (int threads : {2, 3, 8}) {
+        WordCloudGenerator parallel;
+        parallel.setThreadCount(threads);
+        parallel.processText(text);
+        EXPECT_EQ(parallel.frequencies(), sequential.frequencies());
+
+        WordCloudGenerator streamed;
+        streamed.setThreadCount(threads);
+        ASSERT_TRUE(streamed.processFile(file.fileName(), 64));
+        EXPECT_EQ(streamed.frequencies(), sequential.frequencies());
+    }
+}
+
+TEST(WordCloudTest, Utf8TokenizerMatchesRegex) {  // байтовый токенизатор даёт те же слова, что и регулярка
+    QString text = QString::fromUtf8("«Мой ДЯДЯ самых честных правил» — Ёлка, ёЖ; İstanbul KELVIN xK9 Ѐ ґрунт中文 "
+                                     "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnop qrstuvwxyz, Я я а б 42\n");
+    for (int i = 0; i < 20; i++) {
+        text += QString("Word%1 the QUICK brown fox-jumps_over %2 ").arg(i).arg(i * 7);
+    }
+
+    WordCloudGenerator expected;
+    expected.processText(text);
+
+    const Utf8Tokenizer::Simd levels[] = {Utf8Tokenizer::Simd::Scalar, Utf8Tokenizer::Simd::Sse2, Utf8Tokenizer::Simd::Avx2};
+    for (Utf8Tokenizer::Simd level : levels) {
+        if (level > Utf8Tokenizer::detectSimd()) continue;
+
+        QByteArray bytes = text.toUtf8();
+        std::vector<std::string_view> words;
+        Utf8Tokenizer tokenizer(level);
+        tokenizer.tokenize(bytes.data(), static_cast<size_t>(bytes.size()), words);
+
+        WordCountTable table;
+        for (std::string_view word : words) {
+            table.add(word);
+        }
+        EXPECT_EQ(table, expected.frequencies()) << Utf8Tokenizer::simdName(level);
+    }
+}
+
+TEST(WordCloudTest, TopWordsDeterministicTies) {  // равные частоты упорядочены по алфавиту
+    WordCloudGenerator generator;
+    generator.processText("delta alpha charlie bravo alpha bravo echo echo echo");
+
+    const auto &top = generator.topWords(3);
+    ASSERT_GE(top.size(), 3u);
+    EXPECT_EQ(top[0].word, QString("echo"));
+    EXPECT_EQ(top[0].count, 3);
+    EXPECT_EQ(top[1].word, QString("alpha"));
+    EXPECT_EQ(top[2].word, QString("bravo"));
+    EXPECT_EQ(top.size(), 5u);
+
+    generator.addWord(u"delta");
+    generator.addWord(u"delta");
+    generator.addWord(u"delta");
+    EXPECT_EQ(generator.topWords(3)[0].word, QString("delta"));  // кэш сброшен после изменения частот
+}
+
+TEST(WordCloudTest, IncrementalMatchesRecount) {  // добавление и удаление текста даёт то же, что пересчёт окна
+    const QString first = QString::fromUtf8("alpha beta beta gamma Ёж ёж");
+    const QString second = QString::fromUtf8("beta gamma gamma delta ЁЖ");
+    const QString third = QString::fromUtf8("delta delta epsilon alpha");
+
+    WordCloudGenerator incremental;
+    incremental.addText(first);
+    incremental.addText(second);
+    incremental.removeText(first);
+    incremental.addText(third);
+
+    WordCloudGenerator recount;
+    recount.processText(second + " " + third);
+
+    EXPECT_EQ(incremental.frequencies(), recount.frequencies());
+
+    const auto &expected = recount.topWords(10);
+    const auto &actual = incremental.topWords(10);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); i++) {
+        EXPECT_EQ(actual[i].word, expected[i].word);
+        EXPECT_EQ(actual[i].count, expected[i].count);
+    }
+}
+
+TEST(WordCloudTest, ApproximateTopWords) {  // приближённый подсчёт находит те же частые слова с честными границами
+    const QString path = WORDCLOUD_SOURCE_DIR "/text.txt";
+
+    WordCloudGenerator exact;
+    ASSERT_TRUE(exact.processFile(path));
+
+    WordCloudGenerator approximate;
+    approximate.setApproximate(300, 2048);
+    ASSERT_TRUE(approximate.processFile(path));
+
+    const auto &frequencies = exact.frequencies();
+    const auto &top = approximate.topWords(50);
+    ASSERT_FALSE(top.empty());
+    for (const auto &item : top) {
+        const QByteArray utf8 = item.word.toUtf8();
+        const auto truth = frequencies.count(std::string_view(utf8.constData(), utf8.size()));
+        EXPECT_LE(item.count - item.error, truth) << item.word.toStdString();
+        EXPECT_GE(item.count, truth) << item.word.toStdString();
+    }
+
+    // слово, встретившееся чаще границы ошибки, обязано попасть в выдачу
+    const auto &expected = exact.topWords(5);
+    for (const auto &word : expected) {
+        if (word.count <= approximate.approximationError()) continue;
+        bool found = false;
+        for (const auto &item : top) found = found || item.word == word.word;
+        EXPECT_TRUE(found) << word.word.toStdString();
+    }
+}
+
+TEST(WordCloudTest, GlyphCacheReusesEntries) {  // повторный запрос того же слова не создаёт новых шрифтов и текста
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    GlyphCache cache;
+    const GlyphCache::Glyphs first = cache.lookup("Arial", 20, QFont::Bold, "облако");
+    EXPECT_EQ(first.width, QFontMetrics(QFont("Arial", 20, QFont::Bold)).horizontalAdvance("облако"));
+
+    const GlyphCache::Glyphs second = cache.lookup("Arial", 20, QFont::Bold, "облако");
+    EXPECT_EQ(first.text, second.text);
+    EXPECT_EQ(first.font, second.font);
+    EXPECT_EQ(cache.size(), 1u);
+
+    cache.lookup("Arial", 24, QFont::Bold, "облако");
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.fontCount(), 2u);
+}
+
+TEST(WordCloudTest, WordPlacerNoOverlap) {  // разложенные прямоугольники не пересекаются и не выходят за холст
+    WordPlacer placer(400, 300);
+    std::vector<WordPlacer::Box> boxes;
+
+    for (int i = 0; i < 500; i++) {
+        const int width = 20 + (i * 37) % 90;
+        const int height = 10 + (i * 13) % 25;
+        WordPlacer::Box box;
+        if (!placer.place(width, height, 200, 150, box)) continue;
+
+        EXPECT_GE(box.x, 0);
+        EXPECT_GE(box.y, 0);
+        EXPECT_LE(box.x + box.width, 400);
+        EXPECT_LE(box.y + box.height, 300);
+        for (const auto &other : boxes) {
+            const bool overlap = box.x < other.x + other.width && other.x < box.x + box.width
+                && box.y < other.y + other.height && other.y < box.y + box.height;
+            ASSERT_FALSE(overlap) << i;
+        }
+        boxes.push_back(box);
+    }
+
+    EXPECT_GT(boxes.size(), 50u);
+    WordPlacer::Box full;
+    EXPECT_FALSE(placer.place(400, 300, 200, 150, full));
+}
+
+TEST(WordCloudTest, LayoutJsonRoundTrip) {  // раскладка переживает сохранение в JSON и рисуется в другом размере
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    WordCloudGenerator generator;
+    generator.processText("alpha alpha alpha beta beta gamma delta облако облако");
+    const Layout layout = generator.computeLayout(QSize(400, 300));
+    ASSERT_FALSE(layout.words.empty());
+
+    Layout restored;
+    ASSERT_TRUE(Layout::fromJson(layout.toJson(), restored));
+    EXPECT_EQ(restored.reference, layout.reference);
+    ASSERT_EQ(restored.words.size(), layout.words.size());
+    for (size_t i = 0; i < layout.words.size(); i++) {
+        EXPECT_EQ(restored.words[i].text, layout.words[i].text);
+        EXPECT_DOUBLE_EQ(restored.words[i].x, layout.words[i].x);
+        EXPECT_DOUBLE_EQ(restored.words[i].baseline, layout.words[i].baseline);
+        EXPECT_EQ(restored.words[i].color, layout.words[i].color);
+    }
+
+    QImage image(800, 600, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    EXPECT_NO_THROW(restored.render(&painter, image.size()));
+
+    EXPECT_FALSE(Layout::fromJson("{\"width\": 0}", restored));
+}
+
+TEST(WordCloudTest, BatchRendersManifest) {  // пакет рисует все задания, одинаковый seed даёт одинаковую картинку
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    QFile input(dir.filePath("input.txt"));
+    ASSERT_TRUE(input.open(QIODevice::WriteOnly));
+    input.write("alpha alpha beta gamma gamma gamma delta облако облако");
+    input.close();
+
+    QFile manifest(dir.filePath("jobs.tsv"));
+    ASSERT_TRUE(manifest.open(QIODevice::WriteOnly));
+    manifest.write("# input\tshape\twidth\theight\toutput\tseed\n"
+                   "input.txt\tspiral\t300\t200\ta.jpg\t7\n"
+                   "input.txt\tspiral\t300\t200\tb.jpg\t7\n"
+                   "input.txt\theart\t200\t200\tc.jpg\n");
+    manifest.close();
+
+    std::vector<BatchJob> jobs;
+    ASSERT_TRUE(parseManifest(manifest.fileName(), jobs));
+    ASSERT_EQ(jobs.size(), 3u);
+    // seed по умолчанию - стабильный хэш имени выхода, не qHash со случайным зерном процесса
+    EXPECT_EQ(jobs[2].seed, static_cast<quint32>(WordCountTable::hash("c.jpg")));
+    EXPECT_EQ(runBatch(jobs, 3), 0);
+
+    const QImage a(dir.filePath("a.jpg"));
+    const QImage b(dir.filePath("b.jpg"));
+    const QImage c(dir.filePath("c.jpg"));
+    EXPECT_EQ(a.size(), QSize(300, 200));
+    EXPECT_EQ(c.size(), QSize(200, 200));
+    EXPECT_TRUE(a == b);
+}
+
+TEST(WordCloudTest, ServerPipelinesRequests) {  // ответы на пачку запросов приходят по порядку, статистика считает их
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    const QString name = QString("wordcloud-test-%1").arg(QCoreApplication::applicationPid());
+    RenderServer server(2, 16);
+    ASSERT_TRUE(server.listen(name));
+    // второй экземпляр не забирает сокет у работающего сервера
+    RenderServer second(1, 1);
+    EXPECT_FALSE(second.listen(name));
+
+    std::vector<RenderMessage> responses;
+    std::thread client([&]() {
+        QLocalSocket socket;
+        socket.connectToServer(name);
+        if (socket.waitForConnected(5000)) {
+            const QByteArray text = "alpha alpha beta gamma gamma gamma облако";
+            socket.write(encodeFrame(QJsonObject{{"id", 1}, {"shape", "heart"}, {"width", 300}, {"height", 200}}, text));
+            socket.write(encodeFrame(QJsonObject{{"id", 2}, {"shape", "star"}, {"width", 200}, {"height", 200},
+                                                 {"format", "png"}}, text));
+            socket.write(encodeFrame(QJsonObject{{"id", 3}, {"shape", "nonexistent"}}, text));
+            socket.write(encodeFrame(QJsonObject{{"id", 4}, {"type", "stats"}}));
+            // без --serve-root сервер не читает файлы по путям из запроса
+            socket.write(encodeFrame(QJsonObject{{"id", 5}, {"file", QCoreApplication::applicationFilePath()}}));
+            socket.flush();
+
+            QByteArray buffer;
+            RenderMessage response;
+            while (responses.size() < 5 && readFrame(socket, buffer, response, 10000)) {
+                responses.push_back(response);
+            }
+        }
+        QMetaObject::invokeMethod(&app, []() { QCoreApplication::quit(); }, Qt::QueuedConnection);
+    });
+    QTimer::singleShot(30000, &app, []() { QCoreApplication::quit(); });
+    app.exec();
+    client.join();
+
+    ASSERT_EQ(responses.size(), 5u);
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(responses[i].header.value("id").toInt(), i + 1);
+    }
+    EXPECT_TRUE(responses[0].header.value("ok").toBool());
+    EXPECT_EQ(QImage::fromData(responses[0].body, "JPG").size(), QSize(300, 200));
+    EXPECT_EQ(QImage::fromData(responses[1].body, "PNG").size(), QSize(200, 200));
+    EXPECT_FALSE(responses[2].header.value("ok").toBool());
+    // stats разбирается в главном потоке, когда ответы на рисование могли ещё не вернуться
+    EXPECT_TRUE(responses[3].header.contains("p99Us"));
+    EXPECT_FALSE(responses[4].header.value("ok").toBool());
+}
+
+TEST(WordCloudTest, TiledMatchesSingleImage) {  // плитки в несколько потоков дают ту же картинку, что и обычная отрисовка
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    WordCloudGenerator generator;
+    generator.processText("alpha alpha alpha beta beta gamma delta облако облако облако облако");
+    const QSize size(300, 200);
+    const Layout layout = generator.computeLayout(size);
+    ASSERT_FALSE(layout.words.empty());
+
+    QImage tiled(size, QImage::Format_ARGB32);
+    tiled.fill(Qt::black);
+    int bands = 0;
+    const bool done = TiledRenderer(layout, size, 64, 3).render([&](const QImage &band, int y) {
+        QPainter painter(&tiled);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(0, y, band);
+        bands++;
+        return true;
+    });
+
+    EXPECT_TRUE(done);
+    EXPECT_EQ(bands, 4);
+    EXPECT_TRUE(tiled == layout.toImage(size));
+}
+
+TEST(WordCloudTest, OutputFormats) {  // SVG и PDF пишутся без растра, raw совпадает с картинкой и при плитках
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    WordCloudGenerator generator;
+    generator.processText("alpha alpha alpha beta beta gamma облако облако");
+    const QSize size(300, 200);
+    const Layout layout = generator.computeLayout(size);
+    ASSERT_FALSE(layout.words.empty());
+
+    auto write = [&](OutputFormat format, int tileSize) {
+        ImageOptions options;
+        options.format = format;
+        options.tileSize = tileSize;
+        options.threads = 2;
+        QByteArray bytes;
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::WriteOnly);
+        EXPECT_TRUE(writeImage(layout, size, options, buffer));
+        return bytes;
+    };
+
+    const QByteArray svg = write(OutputFormat::Svg, 0);
+    EXPECT_TRUE(svg.startsWith("<svg"));
+    EXPECT_TRUE(svg.contains(">alpha</text>"));
+    EXPECT_TRUE(write(OutputFormat::Pdf, 0).startsWith("%PDF"));
+
+    const QByteArray raw = write(OutputFormat::Raw, 0);
+    ASSERT_EQ(raw.size(), 300 * 200 * 4);
+    EXPECT_EQ(raw.left(4), QByteArray(4, char(0xFF)));
+    EXPECT_EQ(write(OutputFormat::Raw, 64), raw);
+    EXPECT_EQ(QImage::fromData(write(OutputFormat::Png, 0), "PNG").size(), size);
+
+    OutputFormat format;
+    EXPECT_TRUE(outputFormatFromName("JPEG", format));
+    EXPECT_EQ(format, OutputFormat::Jpeg);
+    EXPECT_FALSE(outputFormatFromName("gif", format));
+}
+
+TEST(WordCloudTest, CountSnapshotMerge) {  // слитые снимки шардов дают те же частоты, что и подсчёт всего текста
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    const QString first = "alpha beta beta gamma облако облако облако";
+    const QString second = "beta gamma gamma delta облако zeta";
+
+    WordCloudGenerator shard;
+    shard.processText(first);
+    ASSERT_TRUE(shard.saveCounts(dir.filePath("a.wcc")));
+    shard.processText(second);
+    ASSERT_TRUE(shard.saveCounts(dir.filePath("b.wcc")));
+    shard.clear();
+    ASSERT_TRUE(shard.saveCounts(dir.filePath("empty.wcc")));
+
+    ASSERT_TRUE(mergeCountSnapshots({dir.filePath("a.wcc"), dir.filePath("empty.wcc"), dir.filePath("b.wcc")},
+                                    dir.filePath("merged.wcc")));
+
+    WordCloudGenerator whole;
+    whole.processText(first + " " + second);
+    WordCloudGenerator merged;
+    ASSERT_TRUE(merged.loadCounts(dir.filePath("merged.wcc")));
+    EXPECT_TRUE(merged.frequencies() == whole.frequencies());
+
+    CountSnapshot snapshot;
+    ASSERT_TRUE(snapshot.open(dir.filePath("merged.wcc")));
+    ASSERT_EQ(snapshot.size(), 6u);
+    EXPECT_EQ(snapshot.word(0), "alpha");
+    for (size_t i = 1; i < snapshot.size(); i++) {
+        EXPECT_LT(snapshot.word(i - 1), snapshot.word(i));
+    }
+
+    QFile broken(dir.filePath("broken.wcc"));
+    ASSERT_TRUE(broken.open(QIODevice::WriteOnly));
+    broken.write("WCCOUNTS not really a snapshot");
+    broken.close();
+    EXPECT_FALSE(merged.loadCounts(dir.filePath("broken.wcc")));
+}
+
+TEST(WordCloudTest, RenderCacheEvictsLeastRecentlyUsed) {  // кэш отдаёт сохранённое и при переполнении удаляет давно не использованное
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    RenderCache cache(dir.filePath("cache"), 1000);
+    ASSERT_TRUE(cache.isValid());
+
+    const QByteArray input = RenderCache::hashData("alpha beta gamma");
+    const QByteArray first = RenderCache::key(input, {"spiral", "800"});
+    const QByteArray second = RenderCache::key(input, {"spiral", "600"});
+    const QByteArray third = RenderCache::key(input, {"spiral8", "00"});
+    EXPECT_NE(first, second);
+    EXPECT_NE(first, third);
+
+    QByteArray image;
+    EXPECT_FALSE(cache.lookup(first, image));
+    ASSERT_TRUE(cache.store(first, QByteArray(400, 'a')));
+    ASSERT_TRUE(cache.store(second, QByteArray(400, 'b')));
+
+    // second давно не трогали, first только что прочитан
+    QFile old(dir.filePath("cache/" + QString::fromLatin1(second)));
+    ASSERT_TRUE(old.open(QIODevice::ReadWrite));
+    old.setFileTime(QDateTime::currentDateTimeUtc().addSecs(-3600), QFileDevice::FileModificationTime);
+    old.close();
+    ASSERT_TRUE(cache.lookup(first, image));
+    EXPECT_EQ(image, QByteArray(400, 'a'));
+
+    ASSERT_TRUE(cache.store(third, QByteArray(400, 'c')));
+    EXPECT_TRUE(cache.lookup(first, image));
+    EXPECT_FALSE(cache.lookup(second, image));
+    EXPECT_TRUE(cache.lookup(third, image));
+    EXPECT_EQ(image, QByteArray(400, 'c'));
+    EXPECT_EQ(cache.hits(), 3u);
+    EXPECT_EQ(cache.misses(), 2u);
+}
+
+TEST(WordCloudTest, ProfilerRecordsStages) {  // таймеры и счётчики видят стадии подсчёта и отрисовки, выключенные молчат
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    WordCloudGenerator generator;
+    generator.processText("alpha alpha beta");
+    EXPECT_EQ(Profiler::toJson().value("counters").toObject().value("tokens").toInteger(), 0);
+
+    Profiler::setTracing(true);
+    Profiler::reset();
+    generator.processText("alpha alpha alpha beta beta gamma облако");
+    generator.computeLayout(QSize(300, 200)).toImage(QSize(300, 200), &generator.glyphs());
+    const QJsonObject profile = Profiler::toJson();
+    const QJsonDocument trace = QJsonDocument::fromJson(Profiler::traceJson());
+    Profiler::setEnabled(false);
+    Profiler::reset();
+
+    const QJsonObject stages = profile.value("stages").toObject();
+    for (const char *stage : {"split", "count", "rank", "layout", "draw"}) {
+        EXPECT_EQ(stages.value(stage).toObject().value("calls").toInteger(), 1) << stage;
+    }
+    const QJsonObject counters = profile.value("counters").toObject();
+    EXPECT_EQ(counters.value("tokens").toInteger(), 7);
+    EXPECT_EQ(counters.value("wordsPlaced").toInteger() + counters.value("wordsSkipped").toInteger(), 4);
+    EXPECT_FALSE(trace.object().value("traceEvents").toArray().isEmpty());
+}
+
+TEST(WordCloudTest, IngestMatchesConcatenation) {  // конвейер по многим файлам считает как один склеенный текст
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    ASSERT_TRUE(QDir(dir.path()).mkdir("sub"));
+
+    QString big;
+    for (int i = 0; i < 200; i++) big += QString("облако слово%1 ").arg(i % 7);
+    // последнее слово одного файла и первое следующего не должны склеиться
+    const std::vector<std::pair<QString, QString>> texts = {
+        {"a.txt", "alpha beta beta"},
+        {"b.txt", "gamma delta"},
+        {"c.txt", "delta ELEPHANT"},
+        {"sub/d.txt", big},
+        {"sub/skip.log", "not counted"},
+    };
+
+    QString joined;
+    for (const auto &[name, text] : texts) {
+        QFile file(dir.filePath(name));
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write(text.toUtf8());
+        if (!name.endsWith(".log")) joined += text + "\n";
+    }
+
+    QStringList files;
+    ASSERT_TRUE(collectInputFiles({dir.path()}, files));
+    ASSERT_EQ(files.size(), 4);
+
+    QFile list(dir.filePath("list.lst"));
+    ASSERT_TRUE(list.open(QIODevice::WriteOnly));
+    list.write("a.txt\n\nsub/d.txt\n");
+    list.close();
+    QStringList listed;
+    ASSERT_TRUE(collectInputFiles({"@" + list.fileName(), dir.filePath("[bc].txt")}, listed));
+    EXPECT_EQ(listed, QStringList({dir.filePath("a.txt"), dir.filePath("sub/d.txt"), dir.filePath("b.txt"),
+                                   dir.filePath("c.txt")}));
+
+    WordCloudGenerator whole;
+    whole.processText(joined);
+
+    // крошечные буферы: крупный файл режется на части, мелкие складываются в один буфер
+    IngestOptions options;
+    options.readers = 2;
+    options.batchBytes = 64;
+    options.queueBuffers = 2;
+    WordCloudGenerator pipeline;
+    pipeline.setThreadCount(3);
+    IngestStats stats;
+    ASSERT_TRUE(pipeline.processFiles(files, options, &stats));
+    EXPECT_TRUE(pipeline.frequencies() == whole.frequencies());
+    EXPECT_EQ(stats.files, 4);
+    EXPECT_GT(stats.buffers, 4);
+    EXPECT_EQ(stats.summary().size(), 3);
+
+    EXPECT_FALSE(pipeline.processFiles({dir.filePath("a.txt"), dir.filePath("missing.txt")}, options));
+}
+
+TEST(WordCloudTest, StopWordsAndNormalizers) {  // стоп-слова, минимальная длина и стемминг одинаково работают во всех путях подсчёта
+    const StopWordSet builtin(StopWordSet::English | StopWordSet::Russian);
+    EXPECT_TRUE(builtin.contains("the"));
+    EXPECT_TRUE(builtin.contains("что"));
+    EXPECT_FALSE(builtin.contains("cloud"));
+    EXPECT_FALSE(builtin.contains("облако"));
+    EXPECT_FALSE(StopWordSet().contains("the"));
+
+    StopWordSet custom(StopWordSet::English);
+    custom.addWords({"cloud", "небо"});
+    EXPECT_TRUE(custom.contains("cloud"));
+    EXPECT_TRUE(custom.contains("небо"));
+    EXPECT_TRUE(custom.contains("and"));
+    EXPECT_FALSE(custom.contains("что"));
+
+    EXPECT_EQ(lightStem("облаками"), "облак");
+    EXPECT_EQ(lightStem("облако"), "облак");
+    EXPECT_EQ(lightStem("boxes"), "box");
+    EXPECT_EQ(lightStem("clouds"), "cloud");
+    EXPECT_EQ(lightStem("glass"), "glass");
+    EXPECT_EQ(lightStem("дом"), "дом");
+
+    TokenNormalizer normalizer;
+    normalizer.setStopWords(builtin);
+    normalizer.setMinLength(4);
+    normalizer.setStemming(true);
+
+    const QString text = "The clouds and the cloud, что облако и облаками. Cat cats sky небо облака";
+    WordCloudGenerator single;
+    single.setNormalizer(normalizer);
+    single.processText(text);
+    WordCloudGenerator threaded;
+    threaded.setNormalizer(normalizer);
+    threaded.setThreadCount(3);
+    threaded.processText(text);
+
+    EXPECT_TRUE(single.frequencies() == threaded.frequencies());
+    EXPECT_EQ(single.frequencies().count("the"), 0);
+    EXPECT_EQ(single.frequencies().count("что"), 0);
+    EXPECT_EQ(single.frequencies().count("cloud"), 2);
+    EXPECT_EQ(single.frequencies().count("облак"), 3);
+    EXPECT_EQ(single.frequencies().count("неб"), 1);
+    // "cat" и "sky" короче 4 символов, "cats" становится "cat" уже после проверки длины
+    EXPECT_EQ(single.frequencies().count("sky"), 0);
+    EXPECT_EQ(single.frequencies().count("cat"), 1);
+}
+
+TEST(WordCloudTest, IdfIndexWeightsWords) {  // частое во всех документах слово уступает редкому, индексы частей сливаются
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    const QStringList texts = {"common alpha", "common beta beta", "Common gamma"};
+    QStringList documents;
+    for (qsizetype i = 0; i < texts.size(); i++) {
+        documents.append(dir.filePath(QString("doc%1.txt").arg(i)));
+        QFile file(documents.back());
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write(texts.at(i).toUtf8());
+    }
+
+    ASSERT_TRUE(IdfIndex::build(documents, dir.filePath("all.wcc"), TokenNormalizer(), 2));
+    ASSERT_TRUE(IdfIndex::build(documents.mid(0, 1), dir.filePath("a.wcc"), TokenNormalizer(), 1));
+    ASSERT_TRUE(IdfIndex::build(documents.mid(1), dir.filePath("b.wcc"), TokenNormalizer(), 1));
+    ASSERT_TRUE(mergeCountSnapshots({dir.filePath("a.wcc"), dir.filePath("b.wcc")}, dir.filePath("merged.wcc")));
+
+    auto index = std::make_shared<IdfIndex>();
+    ASSERT_TRUE(index->open(dir.filePath("all.wcc")));
+    IdfIndex merged;
+    ASSERT_TRUE(merged.open(dir.filePath("merged.wcc")));
+    EXPECT_EQ(index->documents(), 3);
+    EXPECT_EQ(merged.documents(), 3);
+    EXPECT_DOUBLE_EQ(index->idf("common"), 1.0);
+    EXPECT_DOUBLE_EQ(index->idf("beta"), std::log(2.0) + 1.0);
+    EXPECT_DOUBLE_EQ(index->idf("unknown"), std::log(4.0) + 1.0);
+    EXPECT_DOUBLE_EQ(merged.idf("beta"), index->idf("beta"));
+
+    // снимок частот без пустого слова - не индекс
+    WordCloudGenerator counts;
+    counts.processText("common rare");
+    ASSERT_TRUE(counts.saveCounts(dir.filePath("counts.wcc")));
+    EXPECT_FALSE(IdfIndex().open(dir.filePath("counts.wcc")));
+
+    WordCloudGenerator generator;
+    generator.processText("common common common rare rare");
+    EXPECT_EQ(generator.topWords(2)[0].word, QString("common"));
+    generator.setIdfIndex(index);
+    EXPECT_EQ(generator.topWords(2)[0].word, QString("rare"));
+    EXPECT_EQ(generator.topWords(2)[0].count, 2);
+    EXPECT_DOUBLE_EQ(generator.topWords(2)[1].weight, 3.0);
+}
+
+TEST(WordCloudTest, IdfRanksWholeTable) {  // с idf инкрементальный подсчёт выбирает те же слова, что и полный
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    // 60 слов есть во всех документах (idf = 1), их частота 3 выше частоты редкого слова
+    QString common;
+    for (int i = 0; i < 60; i++) {
+        common += QString("fill%1%2 ").arg(QChar('a' + i / 26)).arg(QChar('a' + i % 26));
+    }
+    QStringList documents;
+    for (int i = 0; i < 3; i++) {
+        documents.append(dir.filePath(QString("doc%1.txt").arg(i)));
+        QFile file(documents.back());
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write(common.toUtf8());
+    }
+    ASSERT_TRUE(IdfIndex::build(documents, dir.filePath("index.wcc"), TokenNormalizer(), 1));
+    auto index = std::make_shared<IdfIndex>();
+    ASSERT_TRUE(index->open(dir.filePath("index.wcc")));
+
+    const QString text = common + common + common + "rare rare";
+    WordCloudGenerator full;
+    full.setIdfIndex(index);
+    full.processText(text);
+    WordCloudGenerator incremental;
+    incremental.setIdfIndex(index);
+    incremental.addText(text);
+
+    // у "rare" частота 2 - ниже всех 60 слов, но вес 2 * (ln 4 + 1) больше их веса 3
+    ASSERT_EQ(full.topWords(50).size(), incremental.topWords(50).size());
+    EXPECT_EQ(full.topWords(50)[0].word, QString("rare"));
+    for (size_t i = 0; i < full.topWords(50).size(); i++) {
+        EXPECT_EQ(full.topWords(50)[i].word, incremental.topWords(50)[i].word);
+    }
+}
+
+TEST(WordCloudTest, ShapeTablesMatchGeometry) {  // точки форм из таблиц совпадают с геометрией при любом числе слов
+    // круг: равные углы и для готовой таблицы, и для поиска по длинам
+    for (int count : {CircleShape::MAX_WORDS, 7}) {
+        for (int i = 0; i < count; i++) {
+            const UnitPoint point = ShapeTable<CircleShape>::anchor(i, count);
+            EXPECT_NEAR(point.x, 0.33 * std::cos(2 * SHAPE_PI * i / count), 1e-4);
+            EXPECT_NEAR(point.y, 0.33 * std::sin(2 * SHAPE_PI * i / count), 1e-4);
+        }
+    }
+    // у звезды рёбра равны, так что десять слов встают в вершины
+    for (std::size_t k = 0; k < StarShape::VERTICES; k++) {
+        const UnitPoint point = ShapeTable<StarShape>::anchor(static_cast<int>(k), 10);
+        EXPECT_NEAR(point.x, StarShape::vertex(k).x, 1e-12);
+        EXPECT_NEAR(point.y, StarShape::vertex(k).y, 1e-12);
+    }
+
+    EXPECT_EQ(WordCloudGenerator::shapes(), QStringList({"spiral", "circle", "square", "triangle", "heart", "star"}));
+    EXPECT_STREQ(findShape("HEART").name, "heart");
+    EXPECT_STREQ(findShape("boogy-woogy").name, "spiral");
+
+    // четыре слова квадрата - его углы в пикселях; сторона берётся по меньшей стороне холста
+    std::vector<QPoint> corners;
+    findShape("square").anchors(4, QSize(300, 600), corners);
+    ASSERT_EQ(corners.size(), 4u);
+    const QPoint expected[] = {QPoint(50, 200), QPoint(250, 200), QPoint(250, 400), QPoint(50, 400)};
+    for (int i = 0; i < 4; i++) {
+        EXPECT_LE((corners[i] - expected[i]).manhattanLength(), 2);
+    }
+}
+
+TEST(WordCloudTest, ImageMaskKeepsWordsInside) {  // слова из маски не выходят, обработанная маска переживает сохранение
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    // непрозрачна только левая половина картинки
+    QImage image(200, 100, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter(&image).fillRect(QRect(0, 0, 100, 100), Qt::black);
+
+    ImageMask mask;
+    ASSERT_TRUE(mask.fromImage(image));
+    EXPECT_EQ(mask.width(), 200);
+    EXPECT_DOUBLE_EQ(mask.distance(150, 50), 0.0);
+    EXPECT_DOUBLE_EQ(mask.distance(0, 50), 1.0);
+    EXPECT_NEAR(mask.distance(50, 50), 50.0, 0.2);
+    EXPECT_TRUE(mask.inside(0, 0, 100, 100));
+    EXPECT_FALSE(mask.inside(0, 0, 101, 100));
+
+    ImageMask restored;
+    ASSERT_TRUE(restored.fromBytes(mask.toBytes()));
+    EXPECT_EQ(restored.toBytes(), mask.toBytes());
+    EXPECT_FALSE(restored.fromBytes(mask.toBytes().left(100)));
+
+    QImage empty(50, 50, QImage::Format_ARGB32);
+    empty.fill(Qt::transparent);
+    EXPECT_FALSE(ImageMask().fromImage(empty));
+
+    WordCloudGenerator generator;
+    generator.processText("one one one one two two two three three four five six seven eight nine ten eleven");
+    generator.setMask(std::make_shared<ImageMask>(mask));
+    const Layout layout = generator.computeLayout(QSize(400, 200));
+    ASSERT_FALSE(layout.words.empty());
+    EXPECT_EQ(layout.words.front().text, QString("one"));
+    for (const Layout::Word &word : layout.words) {
+        EXPECT_LT(word.x, 0.5) << word.text.toStdString();
+        EXPECT_LE(word.baseline, 1.0);
+    }
+}
+
+TEST(WordCloudTest, FramesKeepWordsInPlace) {  // в кадрах анимации стоят на месте неизменные слова, перерисовываются только изменения
+    int argc = 1;
+    char arg0[] = "test";
+    char* argv[] = {arg0, nullptr};
+    QGuiApplication app(argc, argv);
+
+    const QSize size(400, 300);
+    WordCloudGenerator generator;
+    generator.setShape("circle");
+    WordCloudGenerator::FrameState state;
+    std::vector<QRect> dirty;
+    QImage frame(size, QImage::Format_ARGB32);
+    frame.fill(Qt::white);
+
+    auto position = [](const Layout &layout, const QString &word) {
+        for (const Layout::Word &placed : layout.words) {
+            if (placed.text == word) return QPointF(placed.x, placed.baseline);
+        }
+        return QPointF(-1, -1);
+    };
+
+    generator.processText("alpha alpha alpha beta beta gamma");
+    const Layout first = generator.computeFrame(size, state, dirty);
+    first.repaint(frame, dirty, &generator.glyphs());
+    ASSERT_EQ(first.words.size(), 3u);
+    EXPECT_EQ(state.placed, 3);
+    EXPECT_EQ(frame, first.toImage(size, &generator.glyphs()));
+
+    // у новых слов тот же кегль, что у gamma, а верхняя частота не изменилась
+    generator.processText("alpha alpha alpha beta beta gamma delta");
+    const Layout second = generator.computeFrame(size, state, dirty);
+    second.repaint(frame, dirty, &generator.glyphs());
+    EXPECT_EQ(state.placed, 1);
+    EXPECT_EQ(state.removed, 0);
+    EXPECT_EQ(dirty.size(), 1u);
+    for (const QString word : {"alpha", "beta", "gamma"}) {
+        EXPECT_EQ(position(second, word), position(first, word)) << word.toStdString();
+    }
+    EXPECT_EQ(frame, second.toImage(size, &generator.glyphs()));
+
+    generator.processText("alpha alpha alpha beta beta delta");
+    const Layout third = generator.computeFrame(size, state, dirty);
+    third.repaint(frame, dirty, &generator.glyphs());
+    EXPECT_EQ(state.placed, 0);
+    EXPECT_EQ(state.removed, 1);
+    EXPECT_EQ(position(third, "delta"), position(second, "delta"));
+    EXPECT_EQ(frame, third.toImage(size, &generator.glyphs()));
+}
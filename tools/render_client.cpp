@@ -0,0 +1,94 @@
+// Клиент сервера отрисовки: отправляет один запрос и сохраняет картинку или печатает статистику.
+// Запуск: RenderClient <сокет> [-f файл | -t текст] [-s форма] [-W ширина] [-H высота] [--format jpg|png|bmp|raw|svg|pdf] [-o выход]
+//         RenderClient <сокет> --stats
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include "../RenderProtocol.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Send a render request to a WordCloud --serve process");
+    parser.addHelpOption();
+    parser.addPositionalArgument("socket", "Server socket name");
+    parser.addOption(QCommandLineOption({"f", "file"}, "Text file to render (inside the server's --serve-root)", "file"));
+    parser.addOption(QCommandLineOption({"t", "text"}, "Text to render", "text"));
+    parser.addOption(QCommandLineOption({"s", "shape"}, "Cloud shape", "shape", "spiral"));
+    parser.addOption(QCommandLineOption({"W", "width"}, "Image width in pixels", "pixels", "800"));
+    parser.addOption(QCommandLineOption({"H", "height"}, "Image height in pixels", "pixels", "600"));
+    parser.addOption(QCommandLineOption("format", "Image format: jpg, png, bmp, raw, svg or pdf", "format", "jpg"));
+    parser.addOption(QCommandLineOption({"o", "output"}, "Output image file", "file", "output.jpg"));
+    parser.addOption(QCommandLineOption("stats", "Print server statistics instead of rendering"));
+    parser.process(app);
+    
+    const QStringList args = parser.positionalArguments();
+    
+    if (args.isEmpty()) {
+        qCritical() << "Error: no socket name";
+        return 1;
+    }
+    
+    QLocalSocket socket;
+    socket.connectToServer(args.at(0));
+    
+    if (!socket.waitForConnected(5000)) {
+        qCritical() << "Error: Can`t connect to" << args.at(0);
+        return 1;
+    }
+    
+    QJsonObject header{{"id", 1}};
+    QByteArray body;
+    
+    if (parser.isSet("stats")) {
+        header.insert("type", "stats");
+    } else {
+        header.insert("type", "render");
+        header.insert("shape", parser.value("shape"));
+        header.insert("width", parser.value("width").toInt());
+        header.insert("height", parser.value("height").toInt());
+        header.insert("format", parser.value("format"));
+        if (parser.isSet("file")) {
+            header.insert("file", QFileInfo(parser.value("file")).absoluteFilePath());
+        } else {
+            body = parser.value("text").toUtf8();
+        }
+    }
+    
+    socket.write(encodeFrame(header, body));
+    socket.flush();
+    
+    QByteArray buffer;
+    RenderMessage response;
+    
+    if (!readFrame(socket, buffer, response)) {
+        qCritical() << "Error: No response from the server";
+        return 1;
+    }
+    
+    if (!response.header.value("ok").toBool()) {
+        qCritical() << "Error:" << response.header.value("error").toString();
+        return 1;
+    }
+    
+    if (parser.isSet("stats")) {
+        qInfo().noquote() << QJsonDocument(response.header).toJson(QJsonDocument::Indented);
+        return 0;
+    }
+    
+    QFile output(parser.value("output"));
+    
+    if (!output.open(QIODevice::WriteOnly) || output.write(response.body) != response.body.size()) {
+        qCritical() << "Error: Can`t save an image" << parser.value("output");
+        return 1;
+    }
+    
+    return 0;
+}
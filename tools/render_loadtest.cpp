@@ -0,0 +1,123 @@
+// Нагрузочный тест сервера отрисовки: несколько соединений, в каждом до depth запросов без ожидания ответа.
+// Печатает пропускную способность, перцентили задержки на стороне клиента и статистику сервера.
+// Запуск: RenderLoadTest <сокет> [соединений] [запросов на соединение] [глубина] [text.txt]
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../RenderProtocol.h"
+#include "../Shapes.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    
+    if (args.size() < 2) {
+        qCritical() << "Error: no socket name";
+        return 1;
+    }
+    
+    const QString name = args.at(1);
+    const int connections = args.size() > 2 ? args.at(2).toInt() : 4;
+    const int requests = args.size() > 3 ? args.at(3).toInt() : 100;
+    const int depth = args.size() > 4 ? args.at(4).toInt() : 8;
+    const QString inputFile = args.size() > 5 ? args.at(5) : QStringLiteral("../text.txt");
+    
+    QFile file(inputFile);
+    
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Error: Can`t open file" << inputFile;
+        return 1;
+    }
+    
+    const QByteArray text = file.readAll();
+    
+    std::mutex mutex;
+    std::vector<qint64> latencies;
+    int errors = 0;
+    
+    auto client = [&](int index) {
+        QLocalSocket socket;
+        socket.connectToServer(name);
+        if (!socket.waitForConnected(5000)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            errors += requests;
+            return;
+        }
+        
+        const QStringList &shapes = shapeNames();
+        std::deque<QElapsedTimer> sent;
+        std::vector<qint64> local;
+        QByteArray buffer;
+        int failed = 0;
+        int next = 0;
+        
+        while (next < requests || !sent.empty()) {
+            // держим в полёте до depth запросов
+            while (next < requests && static_cast<int>(sent.size()) < depth) {
+                QJsonObject header{{"id", next}, {"type", "render"}, {"shape", shapes.at((index + next) % shapes.size())},
+                                   {"width", 800}, {"height", 600}, {"format", "jpg"}};
+                socket.write(encodeFrame(header, text));
+                sent.emplace_back();
+                sent.back().start();
+                next++;
+            }
+            socket.flush();
+            
+            RenderMessage response;
+            if (!readFrame(socket, buffer, response)) {
+                failed += static_cast<int>(sent.size()) + (requests - next);
+                break;
+            }
+            local.push_back(sent.front().nsecsElapsed() / 1000);
+            sent.pop_front();
+            if (!response.header.value("ok").toBool()) failed++;
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        latencies.insert(latencies.end(), local.begin(), local.end());
+        errors += failed;
+    };
+    
+    QElapsedTimer total;
+    total.start();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < connections; i++) {
+        threads.emplace_back(client, i);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    const double seconds = total.nsecsElapsed() / 1e9;
+    
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) -> qint64 {
+        if (latencies.empty()) return 0;
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    
+    qInfo().noquote() << QString("requests: %1, errors: %2, %3 s, %4 req/s")
+        .arg(latencies.size()).arg(errors).arg(seconds, 0, 'f', 2).arg(latencies.size() / seconds, 0, 'f', 1);
+    qInfo().noquote() << QString("client latency: p50 %1 ms, p90 %2 ms, p99 %3 ms")
+        .arg(percentile(0.50) / 1000.0, 0, 'f', 1).arg(percentile(0.90) / 1000.0, 0, 'f', 1)
+        .arg(percentile(0.99) / 1000.0, 0, 'f', 1);
+    
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QByteArray buffer;
+    RenderMessage stats;
+    if (socket.waitForConnected(5000) && socket.write(encodeFrame(QJsonObject{{"id", 0}, {"type", "stats"}})) > 0
+        && socket.flush() && readFrame(socket, buffer, stats)) {
+        qInfo().noquote() << "server:" << QJsonDocument(stats.header).toJson(QJsonDocument::Compact);
+    }
+    
+    return errors == 0 ? 0 : 1;
+}